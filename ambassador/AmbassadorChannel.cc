@@ -0,0 +1,246 @@
+/*
+ * Copyright (c) 2020 Fraunhofer FOKUS and others. All rights reserved.
+ *
+ * Contact: mosaic@fokus.fraunhofer.de
+ *
+ * This class is developed for the MOSAIC-OMNeT++ coupling.
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License version 2 as
+ * published by the Free Software Foundation;
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+ *
+ */
+
+#include "AmbassadorChannel.h"
+
+#include <algorithm>
+#include <arpa/inet.h>
+#include <chrono>
+#include <cstring>
+#include <errno.h>
+#include <google/protobuf/io/coded_stream.h>
+#include <iostream>
+#include <netdb.h>
+#include <netinet/tcp.h>
+#include <sys/socket.h>
+#include <sys/un.h>
+#include <unistd.h>
+
+#include "FrameCompression.h"
+#include "ShmChannel.h"
+
+namespace mosaic_ambassador {
+
+using namespace ClientServerChannelSpace;
+
+AmbassadorChannel::~AmbassadorChannel() {
+  flush();
+  if (sock >= 0) {
+    close(sock);
+  }
+  delete shm;
+  delete compression;
+}
+
+bool AmbassadorChannel::connect(const std::string &transport,
+                                const std::string &address, uint32_t port) {
+  for (int attempt = 0; attempt < 300; attempt++) {
+    if (attempt > 0) {
+      usleep(100000);
+    }
+    if (transport == "shm") {
+      shm = new ShmChannel();
+      if (shm->open(address + "-" + std::to_string(port))) {
+        return true;
+      }
+      delete shm;
+      shm = nullptr;
+      continue;
+    }
+    if (transport == "unix") {
+      sockaddr_un addr;
+      memset(&addr, 0, sizeof(addr));
+      addr.sun_family = AF_UNIX;
+      snprintf(addr.sun_path, sizeof(addr.sun_path), "%s-%u", address.c_str(),
+               port);
+      sock = socket(AF_UNIX, SOCK_STREAM, 0);
+      if (::connect(sock, (sockaddr *)&addr, sizeof(addr)) == 0) {
+        return true;
+      }
+    } else {
+      addrinfo hints;
+      memset(&hints, 0, sizeof(hints));
+      hints.ai_family = AF_INET;
+      hints.ai_socktype = SOCK_STREAM;
+      addrinfo *result = nullptr;
+      if (getaddrinfo(address.c_str(), std::to_string(port).c_str(), &hints,
+                      &result) != 0) {
+        std::cerr << "Error: cannot resolve " << address << std::endl;
+        return false;
+      }
+      sock = socket(AF_INET, SOCK_STREAM, 0);
+      const int connected =
+          ::connect(sock, result->ai_addr, result->ai_addrlen);
+      freeaddrinfo(result);
+      if (connected == 0) {
+        int x = 1;
+        setsockopt(sock, IPPROTO_TCP, TCP_NODELAY, &x, sizeof(x));
+        return true;
+      }
+    }
+    close(sock);
+    sock = -1;
+  }
+  std::cerr << "Error: could not connect to federate via " << transport << " "
+            << address << ":" << port << std::endl;
+  return false;
+}
+
+void AmbassadorChannel::writeCommand(CommandMessage_CommandType command) {
+  CommandMessage message;
+  message.set_command_type(command);
+  writeMessage(message);
+}
+
+void AmbassadorChannel::writeMessage(
+    const google::protobuf::MessageLite &message) {
+  if (compression != nullptr) {
+    compression->writeFrame(message, send_buffer);
+    return;
+  }
+  const size_t message_size = message.ByteSizeLong();
+  const size_t offset = send_buffer.size();
+  send_buffer.resize(
+      offset +
+      google::protobuf::io::CodedOutputStream::VarintSize32(message_size) +
+      message_size);
+  uint8_t *target = reinterpret_cast<uint8_t *>(send_buffer.data() + offset);
+  target = google::protobuf::io::CodedOutputStream::WriteVarint32ToArray(
+      message_size, target);
+  message.SerializeWithCachedSizesToArray(target);
+}
+
+bool AmbassadorChannel::flush() {
+  size_t offset = 0;
+  while (offset < send_buffer.size()) {
+    const ssize_t count =
+        shm != nullptr ? shm->send(send_buffer.data() + offset,
+                                   send_buffer.size() - offset)
+                       : ::send(sock, send_buffer.data() + offset,
+                                send_buffer.size() - offset, MSG_NOSIGNAL);
+    if (count < 0) {
+      if (errno == EINTR && shm == nullptr) {
+        continue;
+      }
+      send_buffer.clear();
+      return false;
+    }
+    offset += count;
+  }
+  send_buffer.clear();
+  return true;
+}
+
+CommandMessage_CommandType AmbassadorChannel::readCommand() {
+  CommandMessage message;
+  if (!readMessage(message)) {
+    return CommandMessage_CommandType_UNDEF;
+  }
+  return message.command_type();
+}
+
+bool AmbassadorChannel::readMessage(google::protobuf::MessageLite &message) {
+  uint32_t message_size = 0;
+  for (int num_bytes = 0;; num_bytes++) {
+    if (num_bytes == 5 || !fill(1)) {
+      return false;
+    }
+    const uint8_t byte = recv_buffer[recv_begin++];
+    message_size |= (byte & 0x7F) << (7 * num_bytes);
+    if (!(byte & 0x80)) {
+      break;
+    }
+  }
+  if (!fill(message_size)) {
+    return false;
+  }
+  const char *frame = recv_buffer.data() + recv_begin;
+  recv_begin += message_size;
+  if (compression != nullptr && !compression->readFrame(frame, message_size)) {
+    return false;
+  }
+  return message.ParseFromArray(frame, message_size);
+}
+
+void AmbassadorChannel::enableCompression(size_t threshold) {
+  delete compression;
+  compression = new FrameCompression(threshold);
+}
+
+const FrameCompression *AmbassadorChannel::getCompression() const {
+  return compression;
+}
+
+void AmbassadorChannel::setBusyPoll(std::chrono::nanoseconds duration) {
+  busy_poll = duration;
+  if (shm != nullptr) {
+    shm->setBusyPoll(duration);
+  }
+}
+
+ssize_t AmbassadorChannel::receive(char *buffer, size_t max_bytes) {
+  if (shm != nullptr) {
+    return shm->receive(buffer, max_bytes);
+  }
+  if (busy_poll.count() > 0) {
+    const auto deadline = std::chrono::steady_clock::now() + busy_poll;
+    do {
+      const ssize_t count = recv(sock, buffer, max_bytes, MSG_DONTWAIT);
+      if (count >= 0 || (errno != EAGAIN && errno != EWOULDBLOCK)) {
+        return count;
+      }
+    } while (std::chrono::steady_clock::now() < deadline);
+  }
+  return recv(sock, buffer, max_bytes, 0);
+}
+
+bool AmbassadorChannel::fill(size_t num_bytes) {
+  if (recv_end - recv_begin >= num_bytes) {
+    return true;
+  }
+  if (!flush()) {
+    return false;
+  }
+  if (recv_begin + num_bytes > recv_buffer.size()) {
+    std::memmove(recv_buffer.data(), recv_buffer.data() + recv_begin,
+                 recv_end - recv_begin);
+    recv_end -= recv_begin;
+    recv_begin = 0;
+    if (num_bytes > recv_buffer.size()) {
+      recv_buffer.resize(std::max(num_bytes, 2 * recv_buffer.size()));
+    }
+  }
+  while (recv_end - recv_begin < num_bytes) {
+    const ssize_t count =
+        receive(recv_buffer.data() + recv_end, recv_buffer.size() - recv_end);
+    if (count <= 0) {
+      if (count < 0 && errno == EINTR) {
+        continue;
+      }
+      return false;
+    }
+    recv_end += count;
+  }
+  return true;
+}
+
+} // namespace mosaic_ambassador
@@ -0,0 +1,105 @@
+/*
+ * Copyright (c) 2020 Fraunhofer FOKUS and others. All rights reserved.
+ *
+ * Contact: mosaic@fokus.fraunhofer.de
+ *
+ * This class is developed for the MOSAIC-OMNeT++ coupling.
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License version 2 as
+ * published by the Free Software Foundation;
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+ *
+ */
+
+#ifndef __AMBASSADORCHANNEL_H__
+#define __AMBASSADORCHANNEL_H__
+
+#undef NaN
+#include "ClientServerChannelMessages.pb.h"
+
+#include <chrono>
+#include <string>
+#include <vector>
+
+namespace ClientServerChannelSpace {
+class FrameCompression;
+class ShmChannel;
+}
+
+namespace mosaic_ambassador {
+
+/**
+ * Ambassador side of one channel to the federate. Connects to a channel
+ * prepared by ClientServerChannel and exchanges length prefixed protobuf
+ * messages over TCP, Unix domain sockets or shared memory.
+ */
+class AmbassadorChannel {
+
+public:
+  AmbassadorChannel() = default;
+  virtual ~AmbassadorChannel();
+
+  /**
+   * Connects to the federate, retrying until it listens.
+   *
+   * @param transport "tcp", "unix" or "shm"
+   * @param address host for tcp, path prefix for unix, name prefix for shm
+   * @param port port, or suffix of the socket path / segment name
+   * @return true if connected
+   */
+  virtual bool connect(const std::string &transport,
+                       const std::string &address, uint32_t port);
+
+  /** Buffers a command message. */
+  virtual void writeCommand(ClientServerChannelSpace::CommandMessage_CommandType
+                                command);
+
+  /** Buffers a length prefixed message. */
+  virtual void writeMessage(const google::protobuf::MessageLite &message);
+
+  /** Sends all buffered messages. */
+  virtual bool flush();
+
+  /** Reads a command message, UNDEF if the channel failed. */
+  virtual ClientServerChannelSpace::CommandMessage_CommandType readCommand();
+
+  /** Reads and parses the next message. */
+  virtual bool readMessage(google::protobuf::MessageLite &message);
+
+  /** Flags all following frames, see PROTO_CAP_COMPRESSION. */
+  virtual void enableCompression(size_t threshold);
+
+  /** Compression counters, null if compression is not enabled. */
+  virtual const ClientServerChannelSpace::FrameCompression *
+  getCompression() const;
+
+  /** Polls for this duration without blocking before a read blocks. */
+  virtual void setBusyPoll(std::chrono::nanoseconds duration);
+
+private:
+  int sock = -1;
+  ClientServerChannelSpace::ShmChannel *shm = nullptr;
+  ClientServerChannelSpace::FrameCompression *compression = nullptr;
+
+  std::vector<char> recv_buffer = std::vector<char>(64 * 1024);
+  size_t recv_begin = 0;
+  size_t recv_end = 0;
+  std::vector<char> send_buffer;
+  std::chrono::nanoseconds busy_poll{0};
+
+  bool fill(size_t num_bytes);
+  ssize_t receive(char *buffer, size_t max_bytes);
+};
+
+} // namespace mosaic_ambassador
+
+#endif
@@ -0,0 +1,282 @@
+/*
+ * Copyright (c) 2020 Fraunhofer FOKUS and others. All rights reserved.
+ *
+ * Contact: mosaic@fokus.fraunhofer.de
+ *
+ * This class is developed for the MOSAIC-OMNeT++ coupling.
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License version 2 as
+ * published by the Free Software Foundation;
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+ *
+ */
+
+/**
+ * Stand-in for the MOSAIC OmnetppAmbassador. Connects to a running
+ * omnetpp-federate, initializes it and advances the time in fixed steps while
+ * measuring the duration of each ADVANCE_TIME round trip. This allows to
+ * compare the transports of ClientServerChannel without running MOSAIC:
+ *
+ *   omnetpp-federate omnetpp.ini   (with mosaiceventscheduler-port = 4998)
+ *   mosaic-ambassador-stub --transport shm --port 4998 --end 100 --step 0.001
+ */
+
+#include <algorithm>
+#include <chrono>
+#include <cstdlib>
+#include <cstring>
+#include <iostream>
+#include <string>
+#include <vector>
+
+#include "AmbassadorChannel.h"
+#include "FrameCompression.h"
+
+using namespace ClientServerChannelSpace;
+using namespace mosaic_ambassador;
+
+namespace {
+
+/** Protocol extensions the stub can handle, see Capability */
+uint32_t supportedCapabilities() {
+  uint32_t capabilities =
+      PROTO_CAP_RECEIVE_BATCH | PROTO_CAP_PIPELINED | PROTO_CAP_INTEREST;
+  if (FrameCompression::available()) {
+    capabilities |= PROTO_CAP_COMPRESSION;
+  }
+  return capabilities;
+}
+
+struct Options {
+  std::string transport = "tcp";
+  std::string host = "localhost";
+  std::string socketPath = "/tmp/omnetpp-federate";
+  std::string shmName = "/omnetpp-federate";
+  uint32_t port = 4998;
+  double end = 100;
+  double step = 0.1;
+  uint32_t capabilities = supportedCapabilities();
+  uint32_t compressionThreshold = 1024;
+  double busyPoll = 0;
+};
+
+void printUsage() {
+  std::cout
+      << "Usage: mosaic-ambassador-stub [options]\n"
+         "  --transport tcp|unix|shm  transport configured at the federate\n"
+         "  --host HOST               federate host (tcp)\n"
+         "  --socket-path PATH        mosaiceventscheduler-socket-path (unix)\n"
+         "  --shm-name NAME           mosaiceventscheduler-shm-name (shm)\n"
+         "  --port PORT               mosaiceventscheduler-port\n"
+         "  --end SECONDS             simulated duration\n"
+         "  --step SECONDS            time advance per round trip\n"
+         "  --capabilities MASK       protocol extensions to select if\n"
+         "                            offered, 0 behaves like an old ambassador\n"
+         "  --compression-threshold BYTES\n"
+         "                            smallest compressed message, if selected\n"
+         "  --busy-poll MICROSECONDS  poll this long before a read blocks\n";
+}
+
+bool parseOptions(int argc, char **argv, Options &options) {
+  for (int i = 1; i < argc; i++) {
+    const std::string arg = argv[i];
+    if (arg == "-h" || arg == "--help" || i + 1 == argc) {
+      return false;
+    }
+    const char *value = argv[++i];
+    if (arg == "--transport") {
+      options.transport = value;
+    } else if (arg == "--host") {
+      options.host = value;
+    } else if (arg == "--socket-path") {
+      options.socketPath = value;
+    } else if (arg == "--shm-name") {
+      options.shmName = value;
+    } else if (arg == "--port") {
+      options.port = std::atoi(value);
+    } else if (arg == "--end") {
+      options.end = std::atof(value);
+    } else if (arg == "--step") {
+      options.step = std::atof(value);
+    } else if (arg == "--capabilities") {
+      options.capabilities =
+          std::strtoul(value, nullptr, 0) & supportedCapabilities();
+    } else if (arg == "--compression-threshold") {
+      options.compressionThreshold = std::atoi(value);
+    } else if (arg == "--busy-poll") {
+      options.busyPoll = std::atof(value);
+    } else {
+      return false;
+    }
+  }
+  return true;
+}
+
+const std::string &address(const Options &options) {
+  if (options.transport == "unix") {
+    return options.socketPath;
+  }
+  if (options.transport == "shm") {
+    return options.shmName;
+  }
+  return options.host;
+}
+
+/**
+ * Reads the reports of the federate until it ends the time advance.
+ * @return false if the channel failed
+ */
+bool awaitEnd(AmbassadorChannel &channel) {
+  TimeMessage time;
+  ReceiveMessage receive;
+  ReceiveMessageBatch receiveBatch;
+  CommandErrorMessage error;
+  MobilityInterest interest;
+  for (;;) {
+    switch (channel.readCommand()) {
+    case CommandMessage_CommandType_NEXT_EVENT:
+      channel.readMessage(time);
+      break;
+    case CommandMessage_CommandType_MSG_RECV:
+      channel.readMessage(receive);
+      break;
+    case CommandMessage_CommandType_MSG_RECV_BATCH:
+      channel.readMessage(receiveBatch);
+      break;
+    case CommandMessage_CommandType_MOBILITY_INTEREST:
+      // the stub does not send position updates
+      channel.readMessage(interest);
+      break;
+    case CommandMessage_CommandType_ERROR:
+      channel.readMessage(error);
+      std::cerr << "Warning: federate reported a failed command at t="
+                << error.time() << ": " << error.description() << std::endl;
+      break;
+    case CommandMessage_CommandType_END:
+      return channel.readMessage(time);
+    default:
+      return false;
+    }
+  }
+}
+
+} // namespace
+
+int main(int argc, char **argv) {
+  Options options;
+  if (!parseOptions(argc, argv, options)) {
+    printUsage();
+    return 1;
+  }
+
+  // federate -> ambassador channel, announces the command port
+  AmbassadorChannel federateChannel;
+  if (!federateChannel.connect(options.transport, address(options),
+                               options.port)) {
+    return 1;
+  }
+  PortExchange cmdPort;
+  if (federateChannel.readCommand() != CommandMessage_CommandType_INIT ||
+      !federateChannel.readMessage(cmdPort)) {
+    std::cerr << "Error: federate did not send INIT" << std::endl;
+    return 1;
+  }
+
+  // ambassador -> federate channel
+  AmbassadorChannel cmdChannel;
+  if (!cmdChannel.connect(options.transport, address(options),
+                          cmdPort.port_number())) {
+    return 1;
+  }
+  const int64_t end = static_cast<int64_t>(options.end * 1e9);
+  const int64_t step = std::max<int64_t>(1, options.step * 1e9);
+  InitMessage init;
+  init.set_start_time(0);
+  init.set_end_time(end);
+  const uint32_t capabilities = cmdPort.capabilities() & options.capabilities;
+  if (capabilities != 0) {
+    init.set_capabilities(capabilities);
+  }
+  cmdChannel.writeCommand(CommandMessage_CommandType_INIT);
+  cmdChannel.writeMessage(init);
+  if (cmdChannel.readCommand() != CommandMessage_CommandType_SUCCESS) {
+    std::cerr << "Error: federate did not accept INIT" << std::endl;
+    return 1;
+  }
+  const auto busyPoll = std::chrono::nanoseconds(
+      static_cast<int64_t>(options.busyPoll * 1000));
+  federateChannel.setBusyPoll(busyPoll);
+  cmdChannel.setBusyPoll(busyPoll);
+  if (capabilities & PROTO_CAP_COMPRESSION) {
+    cmdChannel.enableCompression(options.compressionThreshold);
+    federateChannel.enableCompression(options.compressionThreshold);
+  }
+
+  std::vector<double> roundTrips;
+  roundTrips.reserve(end / step + 1);
+  const auto startWall = std::chrono::steady_clock::now();
+  TimeMessage time;
+  for (int64_t t = step; t <= end; t += step) {
+    const auto sent = std::chrono::steady_clock::now();
+    time.set_time(t);
+    cmdChannel.writeCommand(CommandMessage_CommandType_ADVANCE_TIME);
+    cmdChannel.writeMessage(time);
+    cmdChannel.flush();
+    if (!awaitEnd(federateChannel)) {
+      std::cerr << "Error: federate closed the channel at t=" << t << std::endl;
+      return 1;
+    }
+    roundTrips.push_back(std::chrono::duration<double, std::micro>(
+                             std::chrono::steady_clock::now() - sent)
+                             .count());
+  }
+  const double wall = std::chrono::duration<double>(
+                          std::chrono::steady_clock::now() - startWall)
+                          .count();
+
+  // the shut down is executed at the end of the following time advance
+  cmdChannel.writeCommand(CommandMessage_CommandType_SHUT_DOWN);
+  time.set_time(end);
+  cmdChannel.writeCommand(CommandMessage_CommandType_ADVANCE_TIME);
+  cmdChannel.writeMessage(time);
+  cmdChannel.flush();
+
+  if (roundTrips.empty()) {
+    return 0;
+  }
+  std::sort(roundTrips.begin(), roundTrips.end());
+  double sum = 0;
+  for (double rtt : roundTrips) {
+    sum += rtt;
+  }
+  std::cout << "transport:            " << options.transport << "\n"
+            << "capabilities:         " << capabilities << "\n"
+            << "round trips:          " << roundTrips.size() << "\n"
+            << "wall time [s]:        " << wall << "\n"
+            << "sim s per wall s:     " << options.end / wall << "\n"
+            << "round trip mean [us]: " << sum / roundTrips.size() << "\n"
+            << "round trip p50 [us]:  " << roundTrips[roundTrips.size() / 2]
+            << "\n"
+            << "round trip p99 [us]:  "
+            << roundTrips[roundTrips.size() * 99 / 100] << "\n"
+            << "round trip max [us]:  " << roundTrips.back() << std::endl;
+  if (const FrameCompression *compression = federateChannel.getCompression()) {
+    const FrameCompression::Statistics &stats = compression->getStatistics();
+    std::cout << "compressed frames:    " << stats.frames_decompressed << " of "
+              << stats.frames_read << "\n"
+              << "compressed bytes:     " << stats.decompress_bytes_out
+              << " -> " << stats.decompress_bytes_in << "\n"
+              << "decompression [s]:    " << stats.decompress_seconds
+              << std::endl;
+  }
+  return 0;
+}
@@ -0,0 +1,192 @@
+/*
+ * Copyright (c) 2020 Fraunhofer FOKUS and others. All rights reserved.
+ *
+ * Contact: mosaic@fokus.fraunhofer.de
+ *
+ * This class is developed for the MOSAIC-OMNeT++ coupling.
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License version 2 as
+ * published by the Free Software Foundation;
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+ *
+ */
+
+/**
+ * Prints the records of a flight recorder dump written by the federate at
+ * the end of a run, on a failure or on SIGUSR1 (see FlightRecorder.h), the
+ * oldest first:
+ *
+ *   kill -USR1 <federate pid>
+ *   mosaic-flight-recorder --last 100 results/flight-recorder.bin.signal
+ *
+ * Each line holds the sequence number, the wall-clock time relative to the
+ * dump, the simulation time, the event, the command and the size and value
+ * of the record.
+ */
+
+#include <algorithm>
+#include <cstdint>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <fstream>
+#include <iostream>
+#include <iterator>
+#include <string>
+#include <vector>
+
+#include "ChannelStatistics.h"
+#include "FlightRecorder.h"
+
+using namespace ClientServerChannelSpace;
+
+namespace {
+
+struct DumpHeader {
+  uint32_t version;
+  uint32_t recordSize;
+  uint64_t capacity;
+  uint64_t taken;
+  uint64_t startTicks;
+  int64_t startNs;
+  uint64_t dumpTicks;
+  int64_t dumpNs;
+  int64_t startWallNs;
+};
+
+const char *eventName(uint16_t event) {
+  switch (event) {
+  case FLIGHT_COMMAND_IN:
+    return "COMMAND_IN";
+  case FLIGHT_FRAME_IN:
+    return "FRAME_IN";
+  case FLIGHT_FRAME_OUT:
+    return "FRAME_OUT";
+  case FLIGHT_FLUSH:
+    return "FLUSH";
+  case FLIGHT_RECEIVE:
+    return "RECEIVE";
+  case FLIGHT_ADVANCE_TIME:
+    return "ADVANCE_TIME";
+  case FLIGHT_NEXT_EVENT:
+    return "NEXT_EVENT";
+  case FLIGHT_END_ADVANCE:
+    return "END_ADVANCE";
+  case FLIGHT_COMMAND_ERROR:
+    return "COMMAND_ERROR";
+  case FLIGHT_FAILURE:
+    return "FAILURE";
+  default:
+    return "UNKNOWN";
+  }
+}
+
+void printUsage() {
+  std::cout << "Usage: mosaic-flight-recorder [--last COUNT] DUMP\n"
+               "  --last COUNT  print only the newest records\n";
+}
+
+bool readHeader(const std::vector<char> &dump, DumpHeader &header) {
+  if (dump.size() < FlightRecorder::HEADER_SIZE ||
+      std::memcmp(dump.data(), "MOSFLREC", 8) != 0) {
+    std::cerr << "ERROR: not a flight recorder dump" << std::endl;
+    return false;
+  }
+  const char *data = dump.data();
+  std::memcpy(&header.version, data + 8, 4);
+  std::memcpy(&header.recordSize, data + 12, 4);
+  std::memcpy(&header.capacity, data + 16, 8);
+  std::memcpy(&header.taken, data + 24, 8);
+  std::memcpy(&header.startTicks, data + 32, 8);
+  std::memcpy(&header.startNs, data + 40, 8);
+  std::memcpy(&header.dumpTicks, data + 48, 8);
+  std::memcpy(&header.dumpNs, data + 56, 8);
+  std::memcpy(&header.startWallNs, data + 64, 8);
+  if (header.version != FlightRecorder::VERSION ||
+      header.recordSize != sizeof(FlightRecord)) {
+    std::cerr << "ERROR: unsupported flight recorder version "
+              << header.version << std::endl;
+    return false;
+  }
+  if (dump.size() <
+      FlightRecorder::HEADER_SIZE + header.capacity * sizeof(FlightRecord)) {
+    std::cerr << "ERROR: flight recorder dump is truncated" << std::endl;
+    return false;
+  }
+  return true;
+}
+
+} // namespace
+
+int main(int argc, char **argv) {
+  uint64_t last = 0;
+  std::string path;
+  for (int i = 1; i < argc; i++) {
+    const std::string arg = argv[i];
+    if (arg == "--last" && i + 1 < argc) {
+      last = std::strtoull(argv[++i], nullptr, 10);
+    } else if (arg.empty() || arg[0] == '-' || !path.empty()) {
+      printUsage();
+      return 1;
+    } else {
+      path = arg;
+    }
+  }
+  if (path.empty()) {
+    printUsage();
+    return 1;
+  }
+  std::ifstream file(path, std::ios::binary);
+  if (!file) {
+    std::cerr << "ERROR: could not open " << path << std::endl;
+    return 1;
+  }
+  const std::vector<char> dump((std::istreambuf_iterator<char>(file)),
+                               std::istreambuf_iterator<char>());
+  DumpHeader header;
+  if (!readHeader(dump, header)) {
+    return 1;
+  }
+
+  // ns per tick from the clock samples of configure() and the dump
+  const double tickNs =
+      header.dumpTicks > header.startTicks
+          ? static_cast<double>(header.dumpNs - header.startNs) /
+                static_cast<double>(header.dumpTicks - header.startTicks)
+          : 1.0;
+  const uint64_t kept = std::min(header.taken, header.capacity);
+  const uint64_t count = last > 0 ? std::min(last, kept) : kept;
+  const uint64_t first = header.taken - count;
+  std::printf("%llu records taken, %llu kept, wall clock start %.3f s since "
+              "the epoch, dump after %.3f s\n",
+              static_cast<unsigned long long>(header.taken),
+              static_cast<unsigned long long>(kept),
+              header.startWallNs * 1e-9,
+              (header.dumpNs - header.startNs) * 1e-9);
+  std::printf("%12s %14s %16s %-13s %-22s %10s %16s\n", "seq", "dump-ms",
+              "sim-time-s", "event", "command", "size", "value");
+
+  const FlightRecord *ring = reinterpret_cast<const FlightRecord *>(
+      dump.data() + FlightRecorder::HEADER_SIZE);
+  for (uint64_t seq = first; seq < header.taken; seq++) {
+    const FlightRecord &record = ring[seq % header.capacity];
+    // negative, the record was taken before the dump
+    const double dumpMs =
+        static_cast<int64_t>(record.ticks - header.dumpTicks) * tickNs * 1e-6;
+    std::printf("%12llu %14.3f %16.9f %-13s %-22s %10u %16lld\n",
+                static_cast<unsigned long long>(seq), dumpMs,
+                record.sim_time * 1e-9, eventName(record.event),
+                ChannelStatistics::commandName(record.command).c_str(),
+                record.size, static_cast<long long>(record.value));
+  }
+  return 0;
+}
@@ -0,0 +1,706 @@
+/*
+ * Copyright (c) 2020 Fraunhofer FOKUS and others. All rights reserved.
+ *
+ * Contact: mosaic@fokus.fraunhofer.de
+ *
+ * This class is developed for the MOSAIC-OMNeT++ coupling.
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License version 2 as
+ * published by the Free Software Foundation;
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+ *
+ */
+
+/**
+ * Synthetic stand-in for the MOSAIC OmnetppAmbassador. Adds vehicles and
+ * RSUs, configures their radios and drives the federate with position
+ * updates, beacons and time advances at configurable rates, then reports the
+ * simulated seconds per wall-clock second, the round trips and the peak RSS
+ * of the federate:
+ *
+ *   mosaic-load-generator --vehicles 1000 --rsus 20 --end 60 \
+ *       --federate "omnetpp-federate -u Cmdenv omnetpp.ini"
+ *
+ * With --sweep the federate is started once per vehicle count, so that the
+ * scaling of releases can be compared:
+ *
+ *   mosaic-load-generator --sweep 100,1000,5000,20000 --federate "..."
+ */
+
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <cstdlib>
+#include <cstring>
+#include <fstream>
+#include <iostream>
+#include <sstream>
+#include <string>
+#include <sys/resource.h>
+#include <sys/wait.h>
+#include <unistd.h>
+#include <vector>
+
+#include "AmbassadorChannel.h"
+#include "ChannelStatistics.h"
+#include "FrameCompression.h"
+
+using namespace ClientServerChannelSpace;
+using namespace mosaic_ambassador;
+
+namespace {
+
+/** Protocol extensions the generator can handle, see Capability */
+uint32_t supportedCapabilities() {
+  uint32_t capabilities = PROTO_CAP_RECEIVE_BATCH | PROTO_CAP_COMMAND_BATCH |
+                          PROTO_CAP_PIPELINED | PROTO_CAP_INTEREST;
+  if (FrameCompression::available()) {
+    capabilities |= PROTO_CAP_COMPRESSION;
+  }
+  return capabilities;
+}
+
+struct Options {
+  std::string transport = "tcp";
+  std::string host = "localhost";
+  std::string socketPath = "/tmp/omnetpp-federate";
+  std::string shmName = "/omnetpp-federate";
+  uint32_t port = 4998;
+  int vehicles = 100;
+  int rsus = 10;
+  double updateRate = 10;
+  double beaconRate = 10;
+  int beaconSize = 200;
+  double end = 10;
+  double area = 2000;
+  double speed = 14;
+  uint32_t capabilities = supportedCapabilities();
+  uint32_t compressionThreshold = 1024;
+  std::string federate;
+  int federatePid = 0;
+  std::vector<int> sweep;
+};
+
+/** Results of one run. */
+struct Run {
+  int vehicles = 0;
+  uint32_t capabilities = 0;
+  double wall = 0;
+  double simulated = 0;
+  uint64_t roundTrips = 0;
+  uint64_t commands = 0;
+  uint64_t receptions = 0;
+  uint64_t errors = 0;
+  LatencyHistogram advanceNs;
+  /** peak resident set size of the federate in KiB, 0 if unknown */
+  long peakRssKiB = 0;
+};
+
+void printUsage() {
+  std::cout
+      << "Usage: mosaic-load-generator [options]\n"
+         "  --transport tcp|unix|shm  transport configured at the federate\n"
+         "  --host HOST               federate host (tcp)\n"
+         "  --socket-path PATH        mosaiceventscheduler-socket-path (unix)\n"
+         "  --shm-name NAME           mosaiceventscheduler-shm-name (shm)\n"
+         "  --port PORT               mosaiceventscheduler-port\n"
+         "  --vehicles COUNT          vehicles added at the start\n"
+         "  --rsus COUNT              road side units added at the start\n"
+         "  --update-rate HZ          position updates and time advances\n"
+         "                            per simulated second\n"
+         "  --beacon-rate HZ          messages sent per node and second\n"
+         "  --beacon-size BYTES       length of each message\n"
+         "  --end SECONDS             simulated duration\n"
+         "  --area METERS             side of the square the nodes move in\n"
+         "  --speed M/S               speed of the vehicles\n"
+         "  --capabilities MASK       protocol extensions to select if\n"
+         "                            offered, 0 behaves like an old ambassador\n"
+         "  --compression-threshold BYTES\n"
+         "                            smallest compressed message, if selected\n"
+         "  --federate COMMAND        start the federate for each run, its\n"
+         "                            peak RSS is taken when it exits\n"
+         "  --federate-pid PID        read the peak RSS of a running federate\n"
+         "  --sweep COUNT,COUNT,...   one run per vehicle count, needs\n"
+         "                            --federate\n";
+}
+
+bool parseOptions(int argc, char **argv, Options &options) {
+  for (int i = 1; i < argc; i++) {
+    const std::string arg = argv[i];
+    if (arg == "-h" || arg == "--help" || i + 1 == argc) {
+      return false;
+    }
+    const char *value = argv[++i];
+    if (arg == "--transport") {
+      options.transport = value;
+    } else if (arg == "--host") {
+      options.host = value;
+    } else if (arg == "--socket-path") {
+      options.socketPath = value;
+    } else if (arg == "--shm-name") {
+      options.shmName = value;
+    } else if (arg == "--port") {
+      options.port = std::atoi(value);
+    } else if (arg == "--vehicles") {
+      options.vehicles = std::atoi(value);
+    } else if (arg == "--rsus") {
+      options.rsus = std::atoi(value);
+    } else if (arg == "--update-rate") {
+      options.updateRate = std::atof(value);
+    } else if (arg == "--beacon-rate") {
+      options.beaconRate = std::atof(value);
+    } else if (arg == "--beacon-size") {
+      options.beaconSize = std::atoi(value);
+    } else if (arg == "--end") {
+      options.end = std::atof(value);
+    } else if (arg == "--area") {
+      options.area = std::atof(value);
+    } else if (arg == "--speed") {
+      options.speed = std::atof(value);
+    } else if (arg == "--capabilities") {
+      options.capabilities =
+          std::strtoul(value, nullptr, 0) & supportedCapabilities();
+    } else if (arg == "--compression-threshold") {
+      options.compressionThreshold = std::atoi(value);
+    } else if (arg == "--federate") {
+      options.federate = value;
+    } else if (arg == "--federate-pid") {
+      options.federatePid = std::atoi(value);
+    } else if (arg == "--sweep") {
+      std::istringstream counts(value);
+      std::string count;
+      while (std::getline(counts, count, ',')) {
+        options.sweep.push_back(std::atoi(count.c_str()));
+      }
+    } else {
+      return false;
+    }
+  }
+  return options.updateRate > 0 && options.vehicles >= 0 &&
+         options.rsus >= 0 &&
+         (options.sweep.empty() || !options.federate.empty());
+}
+
+const std::string &address(const Options &options) {
+  if (options.transport == "unix") {
+    return options.socketPath;
+  }
+  if (options.transport == "shm") {
+    return options.shmName;
+  }
+  return options.host;
+}
+
+/** Peak resident set size of a running process in KiB, 0 if unknown. */
+long readPeakRss(int pid) {
+  std::ifstream status("/proc/" + std::to_string(pid) + "/status");
+  std::string line;
+  while (std::getline(status, line)) {
+    if (line.compare(0, 6, "VmHWM:") == 0) {
+      return std::atol(line.c_str() + 6);
+    }
+  }
+  return 0;
+}
+
+/**
+ * Sends the commands of one simulated scenario to the federate. Commands are
+ * collected in a COMMAND_BATCH if selected and acknowledged one by one unless
+ * they are pipelined.
+ */
+class LoadGenerator {
+
+public:
+  LoadGenerator(const Options &options, int vehicles)
+      : options(options), vehicles(vehicles), nodes(vehicles + options.rsus) {}
+
+  /** Connects, runs the scenario and shuts the federate down. */
+  bool run(Run &result);
+
+private:
+  const Options &options;
+  const int vehicles;
+  const int nodes;
+  AmbassadorChannel federateChannel;
+  AmbassadorChannel cmdChannel;
+  uint32_t capabilities = 0;
+  CommandBatch batch;
+  uint32_t nextMessageId = 1;
+  /** simulated time of the next message of each node in ns */
+  std::vector<int64_t> nextBeacon;
+  Run *result = nullptr;
+
+  bool connect();
+  bool addNodes();
+  bool advance(int64_t previous, int64_t time);
+
+  void position(int node, int64_t time, double &x, double &y) const;
+  void fillUpdate(UpdateNode &update, UpdateNode_UpdateType type, int first,
+                  int last, int64_t time) const;
+  void fillRadio(ConfigureRadioMessage &radio, int node, int64_t time);
+  void fillBeacon(SendMessageMessage &message, int node, int64_t time);
+
+  bool sendUpdate(const UpdateNode &update);
+  bool sendRadio(const ConfigureRadioMessage &radio);
+  bool sendBeacon(const SendMessageMessage &message);
+  bool sendCommand(CommandMessage_CommandType command,
+                   const google::protobuf::MessageLite &message);
+  bool sendBatch();
+  bool awaitSuccess(int acknowledgements);
+  bool awaitEnd();
+};
+
+bool LoadGenerator::run(Run &result) {
+  this->result = &result;
+  result.vehicles = vehicles;
+  if (!connect()) {
+    return false;
+  }
+  result.capabilities = capabilities;
+  const int64_t end = static_cast<int64_t>(options.end * 1e9);
+  const int64_t step =
+      std::max<int64_t>(1, static_cast<int64_t>(1e9 / options.updateRate));
+  const auto startWall = std::chrono::steady_clock::now();
+  if (!addNodes()) {
+    return false;
+  }
+  int64_t previous = 0;
+  for (int64_t t = step; t <= end; previous = t, t += step) {
+    if (!advance(previous, t)) {
+      std::cerr << "Error: federate closed the channel at t=" << t
+                << std::endl;
+      return false;
+    }
+  }
+  result.wall = std::chrono::duration<double>(std::chrono::steady_clock::now() -
+                                              startWall)
+                    .count();
+  result.simulated = previous * 1e-9;
+  if (options.federatePid > 0) {
+    result.peakRssKiB = readPeakRss(options.federatePid);
+  }
+
+  // the shut down is executed at the end of the following time advance
+  TimeMessage time;
+  cmdChannel.writeCommand(CommandMessage_CommandType_SHUT_DOWN);
+  time.set_time(previous);
+  cmdChannel.writeCommand(CommandMessage_CommandType_ADVANCE_TIME);
+  cmdChannel.writeMessage(time);
+  cmdChannel.flush();
+  return true;
+}
+
+bool LoadGenerator::connect() {
+  // federate -> ambassador channel, announces the command port
+  if (!federateChannel.connect(options.transport, address(options),
+                               options.port)) {
+    return false;
+  }
+  PortExchange cmdPort;
+  if (federateChannel.readCommand() != CommandMessage_CommandType_INIT ||
+      !federateChannel.readMessage(cmdPort)) {
+    std::cerr << "Error: federate did not send INIT" << std::endl;
+    return false;
+  }
+  // ambassador -> federate channel
+  if (!cmdChannel.connect(options.transport, address(options),
+                          cmdPort.port_number())) {
+    return false;
+  }
+  InitMessage init;
+  init.set_start_time(0);
+  init.set_end_time(static_cast<int64_t>(options.end * 1e9));
+  capabilities = cmdPort.capabilities() & options.capabilities;
+  if (capabilities != 0) {
+    init.set_capabilities(capabilities);
+  }
+  cmdChannel.writeCommand(CommandMessage_CommandType_INIT);
+  cmdChannel.writeMessage(init);
+  if (cmdChannel.readCommand() != CommandMessage_CommandType_SUCCESS) {
+    std::cerr << "Error: federate did not accept INIT" << std::endl;
+    return false;
+  }
+  if (capabilities & PROTO_CAP_COMPRESSION) {
+    cmdChannel.enableCompression(options.compressionThreshold);
+    federateChannel.enableCompression(options.compressionThreshold);
+  }
+  return true;
+}
+
+/**
+ * Adds all vehicles and RSUs at time 0 and turns their radios on. The first
+ * beacon of each node is spread evenly over the first beacon interval.
+ */
+bool LoadGenerator::addNodes() {
+  UpdateNode update;
+  if (vehicles > 0) {
+    fillUpdate(update, UpdateNode_UpdateType_ADD_VEHICLE, 0, vehicles, 0);
+    if (!sendUpdate(update)) {
+      return false;
+    }
+  }
+  if (nodes > vehicles) {
+    fillUpdate(update, UpdateNode_UpdateType_ADD_RSU, vehicles, nodes, 0);
+    if (!sendUpdate(update)) {
+      return false;
+    }
+  }
+  ConfigureRadioMessage radio;
+  for (int node = 0; node < nodes; node++) {
+    fillRadio(radio, node, 0);
+    if (!sendRadio(radio)) {
+      return false;
+    }
+  }
+  nextBeacon.resize(nodes, INT64_MAX);
+  if (options.beaconRate > 0) {
+    const double interval = 1e9 / options.beaconRate;
+    for (int node = 0; node < nodes; node++) {
+      nextBeacon[node] = 1 + static_cast<int64_t>(interval * node / nodes);
+    }
+  }
+  return true;
+}
+
+/**
+ * Moves all vehicles to their position at time, sends the beacons due after
+ * previous and advances the federate to time.
+ */
+bool LoadGenerator::advance(int64_t previous, int64_t time) {
+  UpdateNode update;
+  if (vehicles > 0) {
+    fillUpdate(update, UpdateNode_UpdateType_MOVE_NODE, 0, vehicles, time);
+    if (!sendUpdate(update)) {
+      return false;
+    }
+  }
+  SendMessageMessage message;
+  const int64_t interval =
+      options.beaconRate > 0 ? static_cast<int64_t>(1e9 / options.beaconRate)
+                             : 0;
+  for (int node = 0; node < nodes; node++) {
+    while (nextBeacon[node] <= time) {
+      fillBeacon(message, node, std::max(nextBeacon[node], previous));
+      if (!sendBeacon(message)) {
+        return false;
+      }
+      nextBeacon[node] += interval;
+    }
+  }
+  if (!sendBatch()) {
+    return false;
+  }
+  const auto sent = std::chrono::steady_clock::now();
+  TimeMessage advance;
+  advance.set_time(time);
+  cmdChannel.writeCommand(CommandMessage_CommandType_ADVANCE_TIME);
+  cmdChannel.writeMessage(advance);
+  cmdChannel.flush();
+  if (!awaitEnd()) {
+    return false;
+  }
+  result->advanceNs.record(std::chrono::duration_cast<std::chrono::nanoseconds>(
+                               std::chrono::steady_clock::now() - sent)
+                               .count());
+  result->roundTrips++;
+  return true;
+}
+
+/**
+ * Vehicles drive along the x axis at the configured speed and wrap around at
+ * the border of the area, RSUs stand still. All nodes start on a grid.
+ */
+void LoadGenerator::position(int node, int64_t time, double &x,
+                             double &y) const {
+  const int columns = std::max(1, static_cast<int>(std::ceil(std::sqrt(
+                                      static_cast<double>(nodes)))));
+  const double spacing = options.area / columns;
+  x = (node % columns + 0.5) * spacing;
+  y = (node / columns + 0.5) * spacing;
+  if (node < vehicles) {
+    x = std::fmod(x + options.speed * time * 1e-9, options.area);
+  }
+}
+
+void LoadGenerator::fillUpdate(UpdateNode &update, UpdateNode_UpdateType type,
+                               int first, int last, int64_t time) const {
+  update.Clear();
+  update.set_update_type(type);
+  update.set_time(time);
+  for (int node = first; node < last; node++) {
+    UpdateNode_NodeData *properties = update.add_properties();
+    double x, y;
+    position(node, time, x, y);
+    properties->set_id(node);
+    properties->set_x(x);
+    properties->set_y(y);
+  }
+}
+
+void LoadGenerator::fillRadio(ConfigureRadioMessage &radio, int node,
+                              int64_t time) {
+  radio.Clear();
+  radio.set_time(time);
+  radio.set_message_id(nextMessageId++);
+  radio.set_external_id(node);
+  radio.set_radio_number(ConfigureRadioMessage_RadioNumber_SINGLE_RADIO);
+  ConfigureRadioMessage_RadioConfiguration *configuration =
+      radio.mutable_primary_radio_configuration();
+  configuration->set_receiving_messages(true);
+  // 10.0.0.0/8, as MOSAIC assigns them
+  configuration->set_ip_address(0x0A000000u + node + 1);
+  configuration->set_subnet_address(0xFF000000u);
+  configuration->set_transmission_power(50);
+  configuration->set_radio_mode(
+      ConfigureRadioMessage_RadioConfiguration_RadioMode_SINGLE_CHANNEL);
+  configuration->set_primary_radio_channel(PROTO_CCH);
+}
+
+void LoadGenerator::fillBeacon(SendMessageMessage &message, int node,
+                               int64_t time) {
+  message.Clear();
+  message.set_time(time);
+  message.set_node_id(node);
+  message.set_channel_id(PROTO_CCH);
+  message.set_message_id(nextMessageId++);
+  message.set_length(options.beaconSize);
+  // single hop broadcast
+  SendMessageMessage_TopoAddress *address = message.mutable_topo_address();
+  address->set_ip_address(0xFFFFFFFFu);
+  address->set_ttl(1);
+}
+
+bool LoadGenerator::sendUpdate(const UpdateNode &update) {
+  if (capabilities & PROTO_CAP_COMMAND_BATCH) {
+    *batch.add_entries()->mutable_update_node() = update;
+    return true;
+  }
+  return sendCommand(CommandMessage_CommandType_UPDATE_NODE, update);
+}
+
+bool LoadGenerator::sendRadio(const ConfigureRadioMessage &radio) {
+  if (capabilities & PROTO_CAP_COMMAND_BATCH) {
+    *batch.add_entries()->mutable_configure_radio() = radio;
+    return true;
+  }
+  return sendCommand(CommandMessage_CommandType_CONF_RADIO, radio);
+}
+
+bool LoadGenerator::sendBeacon(const SendMessageMessage &message) {
+  if (capabilities & PROTO_CAP_COMMAND_BATCH) {
+    *batch.add_entries()->mutable_send_message() = message;
+    return true;
+  }
+  return sendCommand(CommandMessage_CommandType_MSG_SEND, message);
+}
+
+bool LoadGenerator::sendCommand(CommandMessage_CommandType command,
+                                const google::protobuf::MessageLite &message) {
+  cmdChannel.writeCommand(command);
+  cmdChannel.writeMessage(message);
+  result->commands++;
+  // the federate acknowledges messages and radio configurations once when it
+  // has read them and once when it has applied them
+  const bool twice = command == CommandMessage_CommandType_MSG_SEND ||
+                     command == CommandMessage_CommandType_CONF_RADIO;
+  return (capabilities & PROTO_CAP_PIPELINED) || awaitSuccess(twice ? 2 : 1);
+}
+
+/** Sends the collected batch entries, if any, as one COMMAND_BATCH. */
+bool LoadGenerator::sendBatch() {
+  if (batch.entries_size() == 0) {
+    return true;
+  }
+  result->commands += batch.entries_size();
+  cmdChannel.writeCommand(CommandMessage_CommandType_COMMAND_BATCH);
+  cmdChannel.writeMessage(batch);
+  batch.Clear();
+  return (capabilities & PROTO_CAP_PIPELINED) || awaitSuccess(1);
+}
+
+/**
+ * Waits for the acknowledgement of a command, a round trip of its own. A
+ * failed command is answered with a single ERROR, which is counted like a
+ * reported error in pipelined mode.
+ * @return false if the federate sent anything else
+ */
+bool LoadGenerator::awaitSuccess(int acknowledgements) {
+  result->roundTrips++;
+  CommandErrorMessage error;
+  for (int i = 0; i < acknowledgements; i++) {
+    switch (cmdChannel.readCommand()) {
+    case CommandMessage_CommandType_SUCCESS:
+      break;
+    case CommandMessage_CommandType_ERROR:
+      result->errors++;
+      return cmdChannel.readMessage(error);
+    default:
+      result->errors++;
+      return false;
+    }
+  }
+  return true;
+}
+
+/**
+ * Reads the reports of the federate until it ends the time advance.
+ * @return false if the channel failed
+ */
+bool LoadGenerator::awaitEnd() {
+  TimeMessage time;
+  ReceiveMessage receive;
+  ReceiveMessageBatch receiveBatch;
+  CommandErrorMessage error;
+  MobilityInterest interest;
+  for (;;) {
+    switch (federateChannel.readCommand()) {
+    case CommandMessage_CommandType_NEXT_EVENT:
+      federateChannel.readMessage(time);
+      break;
+    case CommandMessage_CommandType_MSG_RECV:
+      federateChannel.readMessage(receive);
+      result->receptions++;
+      break;
+    case CommandMessage_CommandType_MSG_RECV_BATCH:
+      federateChannel.readMessage(receiveBatch);
+      for (const auto &receptions : receiveBatch.receptions()) {
+        result->receptions += receptions.node_id_size();
+      }
+      break;
+    case CommandMessage_CommandType_MOBILITY_INTEREST:
+      // all vehicles keep being moved, the interest is only read
+      federateChannel.readMessage(interest);
+      break;
+    case CommandMessage_CommandType_ERROR:
+      federateChannel.readMessage(error);
+      result->errors++;
+      break;
+    case CommandMessage_CommandType_END:
+      return federateChannel.readMessage(time);
+    default:
+      return false;
+    }
+  }
+}
+
+/**
+ * Starts the federate, the command replaces the shell so that its peak RSS is
+ * reported by wait4.
+ * @return the process id, -1 if it could not be started
+ */
+int startFederate(const std::string &command) {
+  const int pid = fork();
+  if (pid == 0) {
+    const std::string exec = "exec " + command;
+    execl("/bin/sh", "sh", "-c", exec.c_str(), static_cast<char *>(nullptr));
+    _exit(127);
+  }
+  return pid;
+}
+
+/** Waits for the federate to exit and returns its peak RSS in KiB. */
+long awaitFederate(int pid) {
+  int status;
+  rusage usage;
+  if (wait4(pid, &status, 0, &usage) != pid) {
+    return 0;
+  }
+  if (!WIFEXITED(status) || WEXITSTATUS(status) != 0) {
+    std::cerr << "Warning: federate exited with status " << status
+              << std::endl;
+  }
+  return usage.ru_maxrss;
+}
+
+bool runOnce(const Options &options, int vehicles, Run &result) {
+  const int pid =
+      options.federate.empty() ? 0 : startFederate(options.federate);
+  if (pid < 0) {
+    std::cerr << "Error: could not start the federate" << std::endl;
+    return false;
+  }
+  bool success;
+  {
+    LoadGenerator generator(options, vehicles);
+    success = generator.run(result);
+    // the channels are closed here, so that the federate can exit
+  }
+  if (pid > 0) {
+    result.peakRssKiB = awaitFederate(pid);
+  }
+  return success;
+}
+
+void printRun(const Options &options, const Run &run) {
+  const LatencyHistogram &advance = run.advanceNs;
+  std::cout << "transport:              " << options.transport << "\n"
+            << "capabilities:           " << run.capabilities << "\n"
+            << "vehicles, rsus:         " << run.vehicles << ", "
+            << options.rsus << "\n"
+            << "commands:               " << run.commands << "\n"
+            << "receptions:             " << run.receptions << "\n"
+            << "failed commands:        " << run.errors << "\n"
+            << "round trips:            " << run.roundTrips << "\n"
+            << "wall time [s]:          " << run.wall << "\n"
+            << "sim s per wall s:       " << run.simulated / run.wall << "\n"
+            << "advance mean [us]:      " << advance.getMean() * 1e-3 << "\n"
+            << "advance p50 [us]:       " << advance.getPercentile(50) * 1e-3
+            << "\n"
+            << "advance p99 [us]:       " << advance.getPercentile(99) * 1e-3
+            << "\n"
+            << "advance max [us]:       " << advance.getMax() * 1e-3 << "\n"
+            << "peak RSS [MiB]:         ";
+  if (run.peakRssKiB > 0) {
+    std::cout << run.peakRssKiB / 1024.0 << std::endl;
+  } else {
+    std::cout << "unknown" << std::endl;
+  }
+}
+
+} // namespace
+
+int main(int argc, char **argv) {
+  Options options;
+  if (!parseOptions(argc, argv, options)) {
+    printUsage();
+    return 1;
+  }
+  if (options.sweep.empty()) {
+    Run run;
+    if (!runOnce(options, options.vehicles, run)) {
+      return 1;
+    }
+    printRun(options, run);
+    return 0;
+  }
+
+  std::vector<Run> runs;
+  for (int vehicles : options.sweep) {
+    runs.emplace_back();
+    if (!runOnce(options, vehicles, runs.back())) {
+      return 1;
+    }
+    printRun(options, runs.back());
+  }
+  // one line per run, to be compared across releases
+  std::cout << "\nvehicles,rsus,sim_s_per_wall_s,round_trips,advance_p50_us,"
+               "advance_p99_us,peak_rss_kib\n";
+  for (const Run &run : runs) {
+    std::cout << run.vehicles << "," << options.rsus << ","
+              << run.simulated / run.wall << "," << run.roundTrips << ","
+              << run.advanceNs.getPercentile(50) * 1e-3 << ","
+              << run.advanceNs.getPercentile(99) * 1e-3 << ","
+              << run.peakRssKiB << "\n";
+  }
+  std::cout << std::flush;
+  return 0;
+}
@@ -0,0 +1,197 @@
+/*
+ * Copyright (c) 2020 Fraunhofer FOKUS and others. All rights reserved.
+ *
+ * Contact: mosaic@fokus.fraunhofer.de
+ *
+ * This class is developed for the MOSAIC-OMNeT++ coupling.
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License version 2 as
+ * published by the Free Software Foundation;
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+ *
+ */
+
+/**
+ * Entry point of federate-benchmark. Embeds a simulation like the OMNeT++
+ * embedding sample: parameters take their NED defaults and log output is
+ * discarded. If NEDPATH lists the NED folders of the federate and INET, the
+ * Simulation network is set up for the benchmarks of the scenario manager.
+ */
+
+#include <benchmark/benchmark.h>
+
+#include <cstdlib>
+#include <iostream>
+#include <omnetpp.h>
+#include <sstream>
+#include <string>
+#include <unistd.h>
+#include <vector>
+
+#include "mgmt/MosaicEventScheduler.h"
+
+using namespace omnetpp;
+
+namespace {
+
+class EmptyConfig : public cConfiguration {
+
+protected:
+  class NullKeyValue : public KeyValue {
+  public:
+    virtual const char *getKey() const override { return nullptr; }
+    virtual const char *getValue() const override { return nullptr; }
+    virtual const char *getBaseDirectory() const override { return nullptr; }
+  };
+  NullKeyValue nullKeyValue;
+
+  virtual const char *substituteVariables(const char *value) const override {
+    return value;
+  }
+
+public:
+  virtual const char *getFileName() const override { return nullptr; }
+  virtual const char *getConfigValue(const char *key) const override {
+    return nullptr;
+  }
+  virtual const KeyValue &getConfigEntry(const char *key) const override {
+    return nullKeyValue;
+  }
+  virtual const char *
+  getPerObjectConfigValue(const char *objectFullPath,
+                          const char *keySuffix) const override {
+    return nullptr;
+  }
+  virtual const KeyValue &
+  getPerObjectConfigEntry(const char *objectFullPath,
+                          const char *keySuffix) const override {
+    return nullKeyValue;
+  }
+};
+
+class BenchmarkEnvir : public cNullEnvir {
+
+public:
+  BenchmarkEnvir(int argc, char **argv, cConfiguration *config)
+      : cNullEnvir(argc, argv, config) {}
+
+  virtual void readParameter(cPar *par) override {
+    if (!par->containsValue()) {
+      throw cRuntimeError("no default value for parameter %s",
+                          par->getFullPath().c_str());
+    }
+    par->acceptDefault();
+  }
+};
+
+/** Passes the results on and remembers whether a benchmark failed. */
+template <class Reporter> class FailureReporter : public Reporter {
+
+public:
+  using Reporter::Reporter;
+
+  virtual void ReportRuns(
+      const std::vector<benchmark::BenchmarkReporter::Run> &runs) override {
+    for (const benchmark::BenchmarkReporter::Run &run : runs) {
+      failed = failed || run.error_occurred;
+    }
+    Reporter::ReportRuns(runs);
+  }
+
+  bool failed = false;
+};
+
+/**
+ * Runs the benchmarks with the reporter of --benchmark_format, which a custom
+ * reporter replaces. The deprecated csv format is written as console output.
+ * @return false if a benchmark failed, e.g. a check with SkipWithError
+ */
+bool runBenchmarks(const std::string &format) {
+  if (format == "json") {
+    FailureReporter<benchmark::JSONReporter> reporter;
+    benchmark::RunSpecifiedBenchmarks(&reporter);
+    return !reporter.failed;
+  }
+  FailureReporter<benchmark::ConsoleReporter> reporter(
+      isatty(STDOUT_FILENO) ? benchmark::ConsoleReporter::OO_Defaults
+                            : benchmark::ConsoleReporter::OO_Tabular);
+  benchmark::RunSpecifiedBenchmarks(&reporter);
+  return !reporter.failed;
+}
+
+/** Value of --benchmark_format, read before benchmark::Initialize takes it. */
+std::string benchmarkFormat(int argc, char **argv) {
+  const std::string flag = "--benchmark_format=";
+  std::string format = "console";
+  for (int i = 1; i < argc; i++) {
+    if (std::string(argv[i]).compare(0, flag.size(), flag) == 0) {
+      format = argv[i] + flag.size();
+    }
+  }
+  return format;
+}
+
+/** Loads the NED folders of NEDPATH, returns false if it is not set. */
+bool loadNedFolders() {
+  const char *nedPath = std::getenv("NEDPATH");
+  if (nedPath == nullptr) {
+    return false;
+  }
+  std::istringstream folders(nedPath);
+  std::string folder;
+  while (std::getline(folders, folder, ':')) {
+    if (!folder.empty()) {
+      cSimulation::loadNedSourceFolder(folder.c_str());
+    }
+  }
+  return true;
+}
+
+} // namespace
+
+int main(int argc, char **argv) {
+  // must be the first statement of main
+  cStaticFlag staticFlag;
+  CodeFragments::executeAll(CodeFragments::STARTUP);
+  // simtime-resolution of omnetpp.ini
+  SimTime::setScaleExp(-9);
+
+  const bool withNetwork = loadNedFolders();
+  cSimulation::doneLoadingNedFiles();
+  cSimulation *simulation = new cSimulation(
+      "federate-benchmark", new BenchmarkEnvir(argc, argv, new EmptyConfig()));
+  cSimulation::setActiveSimulation(simulation);
+  simulation->setScheduler(new omnetpp_federate::MosaicEventScheduler());
+  if (withNetwork) {
+    try {
+      simulation->setupNetwork(
+          cModuleType::get("omnetpp_federate.mgmt.Simulation"));
+      simulation->callInitialize();
+    } catch (std::exception &e) {
+      std::cerr << "Simulation network not set up, the scenario manager "
+                   "benchmarks are skipped: "
+                << e.what() << std::endl;
+      simulation->deleteNetwork();
+    }
+  }
+
+  const std::string format = benchmarkFormat(argc, argv);
+  benchmark::Initialize(&argc, argv);
+  const bool succeeded = runBenchmarks(format);
+  benchmark::Shutdown();
+
+  simulation->deleteNetwork();
+  cSimulation::setActiveSimulation(nullptr);
+  delete simulation;
+  CodeFragments::executeAll(CodeFragments::SHUTDOWN);
+  return succeeded ? 0 : 1;
+}
@@ -0,0 +1,265 @@
+/*
+ * Copyright (c) 2020 Fraunhofer FOKUS and others. All rights reserved.
+ *
+ * Contact: mosaic@fokus.fraunhofer.de
+ *
+ * This class is developed for the MOSAIC-OMNeT++ coupling.
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License version 2 as
+ * published by the Free Software Foundation;
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+ *
+ */
+
+/**
+ * Benchmarks of the hot paths of ClientServerChannel. Reads decode frames
+ * preloaded into the receive buffer, so that only decoding is measured.
+ * Writes go to a connected Unix domain socket drained by a second thread.
+ *
+ *   federate-benchmark --benchmark_filter=Channel
+ */
+
+#include <benchmark/benchmark.h>
+
+#include <google/protobuf/io/coded_stream.h>
+#include <memory>
+#include <random>
+#include <string>
+#include <sys/socket.h>
+#include <sys/un.h>
+#include <thread>
+#include <unistd.h>
+#include <vector>
+
+#include "ClientServerChannel.h"
+#include "FlatMessages.h"
+
+namespace ClientServerChannelSpace {
+
+/**
+ * Friend of ClientServerChannel, lets the benchmarks fill its receive buffer
+ * and call its private read methods.
+ */
+class ChannelBenchmark {
+
+public:
+  /** Makes bytes the received but not yet consumed data of the channel. */
+  static void preload(ClientServerChannel &channel, const std::string &bytes,
+                      CMD last_command) {
+    channel.recv_buffer.assign(bytes.begin(), bytes.end());
+    channel.recv_begin = 0;
+    channel.recv_end = bytes.size();
+    channel.last_command = last_command;
+  }
+
+  /** Reads the preloaded data again once it is consumed. */
+  static void rewindIfConsumed(ClientServerChannel &channel) {
+    if (channel.recv_begin == channel.recv_end) {
+      channel.recv_begin = 0;
+    }
+  }
+
+  static bool readVarintPrefix(ClientServerChannel &channel,
+                               uint32_t &value) {
+    return channel.readVarintPrefix(value);
+  }
+};
+
+} // namespace ClientServerChannelSpace
+
+using namespace ClientServerChannelSpace;
+
+namespace {
+
+/** Number of frames preloaded at once, rewinding is rare then. */
+constexpr int PRELOADED_FRAMES = 64;
+
+void appendVarint(std::string &out, uint32_t value) {
+  uint8_t varint[5];
+  const uint8_t *end =
+      google::protobuf::io::CodedOutputStream::WriteVarint32ToArray(value,
+                                                                    varint);
+  out.append(reinterpret_cast<const char *>(varint), end - varint);
+}
+
+void appendFrame(std::string &out, const std::string &frame) {
+  appendVarint(out, frame.size());
+  out += frame;
+}
+
+CSC_update_node_return makeUpdate(int num_nodes) {
+  std::mt19937 random(42);
+  std::uniform_real_distribution<double> position(0, 5000);
+  CSC_update_node_return update;
+  update.type = UPDATE_MOVE_NODE;
+  update.time = 1000000000;
+  update.properties.resize(num_nodes);
+  for (int i = 0; i < num_nodes; i++) {
+    update.properties[i] = {i, position(random), position(random)};
+  }
+  return update;
+}
+
+/** A channel connected to a peer that discards everything it receives. */
+class ConnectedChannel {
+
+public:
+  ConnectedChannel() : channel(new ClientServerChannel()) {
+    const int port =
+        channel->prepareUnixConnection("/tmp/federate-benchmark", 0);
+    peer = std::thread([port] {
+      sockaddr_un address = {};
+      address.sun_family = AF_UNIX;
+      snprintf(address.sun_path, sizeof(address.sun_path),
+               "/tmp/federate-benchmark-%d", port);
+      const int sock = socket(AF_UNIX, SOCK_STREAM, 0);
+      if (::connect(sock, (sockaddr *)&address, sizeof(address)) == 0) {
+        std::vector<char> buffer(1 << 20);
+        while (recv(sock, buffer.data(), buffer.size(), 0) > 0) {
+        }
+      }
+      close(sock);
+    });
+    channel->connect();
+  }
+
+  ~ConnectedChannel() {
+    // closing the socket ends the peer
+    channel.reset();
+    peer.join();
+  }
+
+  ClientServerChannel &operator*() { return *channel; }
+  ClientServerChannel *operator->() { return channel.get(); }
+
+private:
+  std::unique_ptr<ClientServerChannel> channel;
+  std::thread peer;
+};
+
+void BM_ChannelReadVarintPrefix(benchmark::State &state) {
+  std::string bytes;
+  for (int i = 0; i < PRELOADED_FRAMES; i++) {
+    appendVarint(bytes, state.range(0));
+  }
+  ClientServerChannel channel;
+  ChannelBenchmark::preload(channel, bytes, CMD_UNDEF);
+  uint32_t value;
+  for (auto _ : state) {
+    ChannelBenchmark::rewindIfConsumed(channel);
+    ChannelBenchmark::readVarintPrefix(channel, value);
+    benchmark::DoNotOptimize(value);
+  }
+}
+// prefixes of one to four bytes
+BENCHMARK(BM_ChannelReadVarintPrefix)->Arg(100)->Arg(10000)->Arg(1000000)->Arg(
+    100000000);
+
+void BM_ChannelReadUpdateNode(benchmark::State &state) {
+  const CSC_update_node_return update = makeUpdate(state.range(0));
+  UpdateNode message;
+  message.set_update_type(UpdateNode_UpdateType_MOVE_NODE);
+  message.set_time(update.time);
+  for (const CSC_node_data &node : update.properties) {
+    UpdateNode_NodeData *data = message.add_properties();
+    data->set_id(node.id);
+    data->set_x(node.x);
+    data->set_y(node.y);
+  }
+  std::string bytes;
+  for (int i = 0; i < PRELOADED_FRAMES; i++) {
+    appendFrame(bytes, message.SerializeAsString());
+  }
+  ClientServerChannel channel;
+  channel.setAcknowledgeCommands(false);
+  ChannelBenchmark::preload(channel, bytes, CMD_UPDATE_NODE);
+  CSC_update_node_return result;
+  for (auto _ : state) {
+    ChannelBenchmark::rewindIfConsumed(channel);
+    channel.readUpdateNode(result);
+    benchmark::DoNotOptimize(result.properties.data());
+  }
+  state.SetItemsProcessed(state.iterations() * state.range(0));
+  state.SetBytesProcessed(state.iterations() * bytes.size() /
+                          PRELOADED_FRAMES);
+}
+BENCHMARK(BM_ChannelReadUpdateNode)->Arg(10)->Arg(1000)->Arg(10000);
+
+void BM_ChannelReadUpdateNodeFlat(benchmark::State &state) {
+  std::vector<char> frame;
+  flat::encodeUpdateNode(makeUpdate(state.range(0)), frame);
+  std::string bytes;
+  for (int i = 0; i < PRELOADED_FRAMES; i++) {
+    appendFrame(bytes, std::string(frame.begin(), frame.end()));
+  }
+  ClientServerChannel channel;
+  channel.setAcknowledgeCommands(false);
+  channel.setFlatMessages(true);
+  ChannelBenchmark::preload(channel, bytes, CMD_UPDATE_NODE);
+  CSC_update_node_return result;
+  for (auto _ : state) {
+    ChannelBenchmark::rewindIfConsumed(channel);
+    channel.readUpdateNode(result);
+    benchmark::DoNotOptimize(result.properties.data());
+  }
+  state.SetItemsProcessed(state.iterations() * state.range(0));
+  state.SetBytesProcessed(state.iterations() * bytes.size() /
+                          PRELOADED_FRAMES);
+}
+BENCHMARK(BM_ChannelReadUpdateNodeFlat)->Arg(10)->Arg(1000)->Arg(10000);
+
+/** NEXT_EVENT with its time, sent once per time advance. */
+void BM_ChannelWriteTimeMessage(benchmark::State &state) {
+  ConnectedChannel channel;
+  int64_t time = 0;
+  for (auto _ : state) {
+    channel->writeCommand(CMD_NEXT_EVENT);
+    channel->writeTimeMessage(time++);
+    channel->flush();
+  }
+}
+BENCHMARK(BM_ChannelWriteTimeMessage);
+
+/** The given number of receptions as MSG_RECV each, sent with one flush. */
+void BM_ChannelWriteReceiveMessage(benchmark::State &state) {
+  ConnectedChannel channel;
+  channel->setFlatMessages(state.range(1) != 0);
+  int node_id = 0;
+  for (auto _ : state) {
+    for (int i = 0; i < state.range(0); i++) {
+      channel->writeCommand(CMD_MSG_RECV);
+      channel->writeReceiveMessage(1000000000, node_id++, 4711, CCH, 0);
+    }
+    channel->flush();
+  }
+  state.SetItemsProcessed(state.iterations() * state.range(0));
+}
+BENCHMARK(BM_ChannelWriteReceiveMessage)
+    ->ArgNames({"receptions", "flat"})
+    ->ArgsProduct({{1, 100}, {0, 1}});
+
+/** The given number of receptions as one MSG_RECV_BATCH. */
+void BM_ChannelWriteReceiveMessageBatch(benchmark::State &state) {
+  ConnectedChannel channel;
+  int node_id = 0;
+  for (auto _ : state) {
+    for (int i = 0; i < state.range(0); i++) {
+      channel->addReceiveMessage(1000000000, node_id++, 4711, CCH, 0);
+    }
+    channel->writeReceiveMessageBatch();
+    channel->flush();
+  }
+  state.SetItemsProcessed(state.iterations() * state.range(0));
+}
+BENCHMARK(BM_ChannelWriteReceiveMessageBatch)->Arg(1)->Arg(100);
+
+} // namespace
@@ -0,0 +1,293 @@
+/*
+ * Copyright (c) 2020 Fraunhofer FOKUS and others. All rights reserved.
+ *
+ * Contact: mosaic@fokus.fraunhofer.de
+ *
+ * This class is developed for the MOSAIC-OMNeT++ coupling.
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License version 2 as
+ * published by the Free Software Foundation;
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+ *
+ */
+
+/**
+ * Benchmarks of the hot paths of MosaicEventScheduler and
+ * MosaicScenarioManager within the simulation set up by BenchmarkMain.cc.
+ * The scheduler is not started, so no connection to MOSAIC is needed:
+ *
+ *   NEDPATH=src:<inet>/src federate-benchmark --benchmark_filter=Scheduler
+ */
+
+#include <benchmark/benchmark.h>
+
+#include <cstdlib>
+#include <omnetpp.h>
+#include <random>
+#include <set>
+#include <vector>
+
+#include "mgmt/MosaicEventScheduler.h"
+#include "mgmt/MosaicScenarioManager.h"
+#include "msg/MosaicMobilityCmd_m.h"
+
+namespace omnetpp_federate {
+
+/** Friend of MosaicEventScheduler, calls its private command processing. */
+class SchedulerBenchmark {
+
+public:
+  static MosaicMobilityCmd *
+  processUpdateNodeCommand(MosaicEventScheduler &scheduler,
+                           CSC_update_node_return &update,
+                           MobilityCommandType type) {
+    return scheduler.processUpdateNodeCommand(update.properties.size(),
+                                              update, type);
+  }
+
+  static void setMoveEpsilon(MosaicEventScheduler &scheduler,
+                             double epsilon) {
+    scheduler.m_moveEpsilon = epsilon;
+  }
+};
+
+} // namespace omnetpp_federate
+
+using namespace omnetpp;
+using namespace omnetpp_federate;
+
+namespace {
+
+MosaicEventScheduler &scheduler() {
+  return *check_and_cast<MosaicEventScheduler *>(
+      cSimulation::getActiveSimulation()->getScheduler());
+}
+
+/** The scenario manager of the network, null if it could not be set up. */
+MosaicScenarioManager *scenarioManager() {
+  cModule *network = cSimulation::getActiveSimulation()->getSystemModule();
+  return network != nullptr ? dynamic_cast<MosaicScenarioManager *>(
+                                  network->getSubmodule("mgmt"))
+                            : nullptr;
+}
+
+CSC_update_node_return makeUpdate(int num_nodes) {
+  std::mt19937 random(42);
+  std::uniform_real_distribution<double> position(0, 5000);
+  CSC_update_node_return update;
+  update.type = UPDATE_MOVE_NODE;
+  update.time = 1000000000;
+  update.properties.resize(num_nodes);
+  for (int i = 0; i < num_nodes; i++) {
+    update.properties[i] = {i, position(random), position(random)};
+  }
+  return update;
+}
+
+MosaicMobilityCmd *makeMobilityCmd(MobilityCommandType type,
+                                   const CSC_update_node_return &update) {
+  auto *cmd = new MosaicMobilityCmd("MosaicMobilityCmd");
+  cmd->setCmdType(type);
+  cmd->setNodeIdArraySize(update.properties.size());
+  cmd->setPositionArraySize(update.properties.size());
+  for (size_t i = 0; i < update.properties.size(); i++) {
+    cmd->setNodeId(i, update.properties[i].id);
+    cmd->setPosition(
+        i, inet::Coord(update.properties[i].x, update.properties[i].y, 0));
+  }
+  return cmd;
+}
+
+/**
+ * Conversion of an UPDATE_NODE into a MosaicMobilityCmd. With a move epsilon
+ * of 1 m, every move after the first is skipped as it repeats the position.
+ */
+void BM_SchedulerProcessUpdateNodeCommand(benchmark::State &state) {
+  CSC_update_node_return update = makeUpdate(state.range(0));
+  SchedulerBenchmark::setMoveEpsilon(scheduler(), state.range(1));
+  for (auto _ : state) {
+    MosaicMobilityCmd *cmd = SchedulerBenchmark::processUpdateNodeCommand(
+        scheduler(), update, MOBILITY_CMD_MOVE_NODES);
+    benchmark::DoNotOptimize(cmd);
+    delete cmd;
+  }
+  SchedulerBenchmark::setMoveEpsilon(scheduler(), 0);
+  state.SetItemsProcessed(state.iterations() * state.range(0));
+}
+BENCHMARK(BM_SchedulerProcessUpdateNodeCommand)
+    ->ArgNames({"nodes", "epsilon"})
+    ->ArgsProduct({{10, 1000, 10000}, {0, 1}});
+
+/** Inserting a command into a future event set of the given size. */
+void BM_SchedulerPutBackEvent(benchmark::State &state) {
+  cFutureEventSet *fes = cSimulation::getActiveSimulation()->getFES();
+  std::mt19937 random(42);
+  std::uniform_int_distribution<int64_t> time(1, 100000000000);
+  std::vector<cMessage *> pending(state.range(0));
+  for (cMessage *&message : pending) {
+    message = new cMessage("pending");
+    message->setArrivalTime(SimTime(time(random), SIMTIME_NS));
+    fes->insert(message);
+  }
+  cMessage *command = new cMessage("command");
+  for (auto _ : state) {
+    command->setArrivalTime(SimTime(time(random), SIMTIME_NS));
+    scheduler().putBackEvent(command);
+    fes->remove(command);
+  }
+  delete command;
+  for (cMessage *message : pending) {
+    fes->remove(message);
+    delete message;
+  }
+}
+BENCHMARK(BM_SchedulerPutBackEvent)->Arg(100)->Arg(10000)->Arg(100000);
+
+/**
+ * Removes all events from the FES in their order. Events of the network are
+ * inserted again in that order, so their relative order is kept.
+ */
+std::vector<cEvent *> popOwnEvents(cFutureEventSet *fes,
+                                   const std::set<cEvent *> &own) {
+  std::vector<cEvent *> order;
+  std::vector<cEvent *> network;
+  while (!fes->isEmpty()) {
+    cEvent *event = fes->removeFirst();
+    (own.count(event) != 0 ? order : network).push_back(event);
+  }
+  for (cEvent *event : network) {
+    fes->insert(event);
+  }
+  return order;
+}
+
+/**
+ * A burst of commands with equal time and priority among pending events of
+ * equal and random times. Before the loop it checks that the events leave
+ * the FES in the same order as they did when putBackEvent sorted the FES
+ * after each insert, the loop measures the inserts of the burst.
+ */
+void BM_SchedulerPutBackEventOrder(benchmark::State &state) {
+  cFutureEventSet *fes = cSimulation::getActiveSimulation()->getFES();
+  const SimTime burstTime(5, SIMTIME_S);
+  std::mt19937 random(42);
+  std::uniform_int_distribution<int64_t> time(1, 10);
+  std::uniform_int_distribution<int> priority(-1, 1);
+  std::vector<cMessage *> pending(state.range(0));
+  for (cMessage *&message : pending) {
+    message = new cMessage("pending");
+    message->setArrivalTime(SimTime(time(random), SIMTIME_S));
+    message->setSchedulingPriority(priority(random));
+  }
+  std::vector<cMessage *> burst(state.range(1));
+  for (cMessage *&message : burst) {
+    message = new cMessage("command");
+    message->setArrivalTime(burstTime);
+  }
+  std::set<cEvent *> own(pending.begin(), pending.end());
+  own.insert(burst.begin(), burst.end());
+
+  std::vector<cEvent *> expected;
+  {
+    cEventHeap reference("reference");
+    for (cMessage *message : pending) {
+      reference.insert(message);
+    }
+    for (cMessage *message : burst) {
+      reference.insert(message);
+      reference.sort();
+    }
+    while (!reference.isEmpty()) {
+      expected.push_back(reference.removeFirst());
+    }
+  }
+  for (cMessage *message : pending) {
+    fes->insert(message);
+  }
+  for (cMessage *message : burst) {
+    scheduler().putBackEvent(message);
+  }
+  if (popOwnEvents(fes, own) != expected) {
+    state.SkipWithError("events leave the FES in another order than with "
+                        "sort() after each insert");
+  } else {
+    for (cMessage *message : pending) {
+      fes->insert(message);
+    }
+    for (auto _ : state) {
+      for (cMessage *message : burst) {
+        scheduler().putBackEvent(message);
+      }
+      state.PauseTiming();
+      for (cMessage *message : burst) {
+        fes->remove(message);
+      }
+      state.ResumeTiming();
+    }
+    for (cMessage *message : pending) {
+      fes->remove(message);
+    }
+    state.SetItemsProcessed(state.iterations() * state.range(1));
+  }
+  for (cMessage *message : pending) {
+    delete message;
+  }
+  for (cMessage *message : burst) {
+    delete message;
+  }
+}
+BENCHMARK(BM_SchedulerPutBackEventOrder)
+    ->ArgNames({"pending", "burst"})
+    ->ArgsProduct({{1000, 100000}, {1000}});
+
+/**
+ * Dispatch of a MOVE command to the mobility of the given number of
+ * vehicles, which are added once.
+ */
+void BM_ScenarioManagerHandleMove(benchmark::State &state) {
+  MosaicScenarioManager *manager = scenarioManager();
+  if (manager == nullptr) {
+    state.SkipWithError("the Simulation network could not be set up");
+    return;
+  }
+  static int numAdded = 0;
+  const CSC_update_node_return update = makeUpdate(state.range(0));
+  if (numAdded < state.range(0)) {
+    CSC_update_node_return added = makeUpdate(state.range(0));
+    added.properties.erase(added.properties.begin(),
+                           added.properties.begin() + numAdded);
+    manager->handleMessage(makeMobilityCmd(MOBILITY_CMD_ADD_NODES, added));
+    numAdded = state.range(0);
+  }
+  const MosaicMobilityCmd *move =
+      makeMobilityCmd(MOBILITY_CMD_MOVE_NODES, update);
+  for (auto _ : state) {
+    state.PauseTiming();
+    cMessage *cmd = move->dup();
+    state.ResumeTiming();
+    // deletes the command
+    manager->handleMessage(cmd);
+  }
+  delete move;
+  state.SetItemsProcessed(state.iterations() * state.range(0));
+}
+// without NEDPATH there is no network, the benchmark is left out instead of
+// failing the run
+const bool scenarioManagerBenchmarks =
+    std::getenv("NEDPATH") != nullptr &&
+    benchmark::RegisterBenchmark("BM_ScenarioManagerHandleMove",
+                                 BM_ScenarioManagerHandleMove)
+            ->Arg(1)
+            ->Arg(100)
+            ->Arg(1000) != nullptr;
+
+} // namespace
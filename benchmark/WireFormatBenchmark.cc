@@ -0,0 +1,181 @@
+/*
+ * Copyright (c) 2020 Fraunhofer FOKUS and others. All rights reserved.
+ *
+ * Contact: mosaic@fokus.fraunhofer.de
+ *
+ * This class is developed for the MOSAIC-OMNeT++ coupling.
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License version 2 as
+ * published by the Free Software Foundation;
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+ *
+ */
+
+/**
+ * Compares decoding and encoding of the most frequent messages as protobuf and
+ * in the fixed layout of FlatMessages.h, the way ClientServerChannel does:
+ *
+ *   wire-format-benchmark --benchmark_filter=UpdateNode
+ */
+
+#include <benchmark/benchmark.h>
+
+#include <random>
+#include <string>
+#include <vector>
+
+#include "FlatMessages.h"
+
+using namespace ClientServerChannelSpace;
+
+namespace {
+
+CSC_update_node_return makeUpdate(int num_nodes) {
+  std::mt19937 random(42);
+  std::uniform_real_distribution<double> position(0, 5000);
+  CSC_update_node_return update;
+  update.type = UPDATE_MOVE_NODE;
+  update.time = 1000000000;
+  update.properties.resize(num_nodes);
+  for (int i = 0; i < num_nodes; i++) {
+    update.properties[i] = {i, position(random), position(random)};
+  }
+  return update;
+}
+
+CSC_send_message makeSendMessage() {
+  CSC_send_message message;
+  message.time = 1000000000;
+  message.node_id = 42;
+  message.channel_id = CCH;
+  message.message_id = 4711;
+  message.length = 200;
+  message.topo_address = {0xFFFFFFFF, 1};
+  return message;
+}
+
+void BM_UpdateNodeProtobuf(benchmark::State &state) {
+  const CSC_update_node_return update = makeUpdate(state.range(0));
+  UpdateNode message;
+  message.set_update_type(UpdateNode_UpdateType_MOVE_NODE);
+  message.set_time(update.time);
+  for (const CSC_node_data &node : update.properties) {
+    UpdateNode_NodeData *data = message.add_properties();
+    data->set_id(node.id);
+    data->set_x(node.x);
+    data->set_y(node.y);
+  }
+  const std::string frame = message.SerializeAsString();
+  UpdateNode parsed;
+  CSC_update_node_return result;
+  for (auto _ : state) {
+    parsed.ParseFromArray(frame.data(), frame.size());
+    result.type = static_cast<UPDATE_NODE_TYPE>(parsed.update_type());
+    result.time = parsed.time();
+    result.properties.resize(parsed.properties_size());
+    for (int i = 0; i < parsed.properties_size(); i++) {
+      const UpdateNode_NodeData &data = parsed.properties(i);
+      result.properties[i] = {data.id(), data.x(), data.y()};
+    }
+    benchmark::DoNotOptimize(result.properties.data());
+  }
+  state.SetBytesProcessed(state.iterations() * frame.size());
+  state.counters["frame_bytes"] = frame.size();
+}
+BENCHMARK(BM_UpdateNodeProtobuf)->Arg(10)->Arg(1000)->Arg(10000);
+
+void BM_UpdateNodeFlat(benchmark::State &state) {
+  const CSC_update_node_return update = makeUpdate(state.range(0));
+  std::vector<char> frame;
+  flat::encodeUpdateNode(update, frame);
+  CSC_update_node_return result;
+  for (auto _ : state) {
+    flat::decodeUpdateNode(frame.data(), frame.size(), result);
+    benchmark::DoNotOptimize(result.properties.data());
+  }
+  state.SetBytesProcessed(state.iterations() * frame.size());
+  state.counters["frame_bytes"] = frame.size();
+}
+BENCHMARK(BM_UpdateNodeFlat)->Arg(10)->Arg(1000)->Arg(10000);
+
+void BM_SendMessageProtobuf(benchmark::State &state) {
+  const CSC_send_message send = makeSendMessage();
+  SendMessageMessage message;
+  message.set_time(send.time);
+  message.set_node_id(send.node_id);
+  message.set_channel_id(PROTO_CCH);
+  message.set_message_id(send.message_id);
+  message.set_length(send.length);
+  message.mutable_topo_address()->set_ip_address(send.topo_address.ip_address);
+  message.mutable_topo_address()->set_ttl(send.topo_address.ttl);
+  const std::string frame = message.SerializeAsString();
+  SendMessageMessage parsed;
+  CSC_send_message result;
+  for (auto _ : state) {
+    parsed.ParseFromArray(frame.data(), frame.size());
+    result.time = parsed.time();
+    result.node_id = parsed.node_id();
+    result.channel_id = static_cast<RADIO_CHANNEL>(parsed.channel_id());
+    result.message_id = parsed.message_id();
+    result.length = parsed.length();
+    result.topo_address.ip_address = parsed.topo_address().ip_address();
+    result.topo_address.ttl = parsed.topo_address().ttl();
+    benchmark::DoNotOptimize(result);
+  }
+  state.counters["frame_bytes"] = frame.size();
+}
+BENCHMARK(BM_SendMessageProtobuf);
+
+void BM_SendMessageFlat(benchmark::State &state) {
+  std::vector<char> frame;
+  flat::encodeSendMessage(makeSendMessage(), frame);
+  CSC_send_message result;
+  for (auto _ : state) {
+    flat::decodeSendMessage(frame.data(), frame.size(), result);
+    benchmark::DoNotOptimize(result);
+  }
+  state.counters["frame_bytes"] = frame.size();
+}
+BENCHMARK(BM_SendMessageFlat);
+
+void BM_ReceiveMessageProtobuf(benchmark::State &state) {
+  std::vector<uint8_t> buffer(64);
+  int node_id = 0;
+  for (auto _ : state) {
+    ReceiveMessage message;
+    message.set_time(1000000000);
+    message.set_node_id(node_id++);
+    message.set_message_id(4711);
+    message.set_channel_id(PROTO_CCH);
+    message.set_rssi(0);
+    // as ClientServerChannel::writeMessage, sizes are computed first
+    const size_t size = message.ByteSizeLong();
+    message.SerializeWithCachedSizesToArray(buffer.data());
+    benchmark::DoNotOptimize(size);
+    benchmark::DoNotOptimize(buffer.data());
+  }
+}
+BENCHMARK(BM_ReceiveMessageProtobuf);
+
+void BM_ReceiveMessageFlat(benchmark::State &state) {
+  char buffer[flat::RECEIVE_MESSAGE_SIZE];
+  int node_id = 0;
+  for (auto _ : state) {
+    flat::encodeReceiveMessage(1000000000, node_id++, 4711, CCH, 0, buffer);
+    benchmark::DoNotOptimize(buffer);
+  }
+}
+BENCHMARK(BM_ReceiveMessageFlat);
+
+} // namespace
+
+BENCHMARK_MAIN();
@@ -38,6 +38,21 @@ newoption {
    description = "Generate/Regenerate protocol buffers with protobuf compiler"
 }
 
+newoption {
+   trigger     = "with-lz4",
+   description = "Support LZ4 compression of large frames (requires liblz4)"
+}
+
+newoption {
+   trigger     = "with-release-logging",
+   description = "Keep the info and trace logs of the channel in release builds"
+}
+
+newoption {
+   trigger     = "with-benchmarks",
+   description = "Build the benchmarks (requires google benchmark)"
+}
+
 newoption {
    trigger     = "install",
    description = "install target into '" .. install_prefix .. "'"
@@ -67,6 +82,20 @@ project "omnetpp-federate-LIBRARY"
         , PROTO_CC_PATH .. "/ClientServerChannel.cc"
         , "src/util/Log.h"
         , "src/util/Log.cc"
+        , "src/util/ShmChannel.h"
+        , "src/util/ShmChannel.cc"
+        , "src/util/ChannelStatistics.h"
+        , "src/util/ChannelStatistics.cc"
+        , "src/util/FrameCompression.h"
+        , "src/util/FrameCompression.cc"
+        , "src/util/FrameTrace.h"
+        , "src/util/FrameTrace.cc"
+        , "src/util/FlatMessages.h"
+        , "src/util/FlatMessages.cc"
+        , "src/util/FlightRecorder.h"
+        , "src/util/FlightRecorder.cc"
+        , "src/util/SpanTrace.h"
+        , "src/util/SpanTrace.cc"
         , PROTO_CC_PATH .. "/ClientServerChannelMessages.pb.h"
         , PROTO_CC_PATH .. "/ClientServerChannelMessages.pb.cc"
         }
@@ -83,7 +112,7 @@ project "omnetpp-federate-LIBRARY"
   libdirs { "/usr/lib" }
 
   buildoptions { "-std=c++17"}
-  links { "protobuf" }
+  links { "protobuf", "pthread", "rt" }
 
   filter "configurations:Debug"
      defines { "DEBUG" }
@@ -93,6 +122,13 @@ project "omnetpp-federate-LIBRARY"
      defines { "NDEBUG" }
      optimize "On"
 
+  configuration "with-lz4"
+     defines { "WITH_LZ4" }
+     links { "lz4" }
+
+  configuration "with-release-logging"
+     defines { "LOG_COMPILED_LEVEL=LOG_LEVEL_ALL" }
+
   configuration "generate-opp-messages"
      prebuildcommands { OPP_MSGC_BIN .. " --msg6 -I /usr/lib" .. " src/msg/MosaicCommunicationCmd.msg"
                       , OPP_MSGC_BIN .. " --msg6 -I /usr/lib" .. " src/msg/MosaicConfigurationCmd.msg"
@@ -190,9 +226,219 @@ project "omnetpp-federate-BINARY"
    configuration "Release"
       libdirs { "bin/Release", "/usr/lib" }
 
+-- ----------------------------------------
+-- target: bin/mosaic-ambassador-stub --
+-- ----------------------------------------
+
+project "mosaic-ambassador-stub"
+   targetname "mosaic-ambassador-stub"
+   kind "ConsoleApp"
+
+   files { "ambassador/AmbassadorChannel.h"
+         , "ambassador/AmbassadorChannel.cc"
+         , "ambassador/AmbassadorStub.cc"
+         , "src/util/ShmChannel.h"
+         , "src/util/ShmChannel.cc"
+         , "src/util/FrameCompression.h"
+         , "src/util/FrameCompression.cc"
+         , PROTO_CC_PATH .. "/ClientServerChannelMessages.pb.h"
+         , PROTO_CC_PATH .. "/ClientServerChannelMessages.pb.cc"
+         }
+
+   includedirs { "/usr/include"
+               , "ambassador"
+               , "src/util"
+               , PROTO_CC_PATH
+               }
+
+   buildoptions { "-std=c++17" }
+   links { "protobuf", "pthread", "rt" }
+
+   configuration "with-lz4"
+      defines { "WITH_LZ4" }
+      links { "lz4" }
+
+   filter "configurations:Debug"
+      defines { "DEBUG" }
+      symbols "On"
+
+   filter "configurations:Release"
+      defines { "NDEBUG" }
+      optimize "On"
+
+-- ---------------------------------------
+-- target: bin/mosaic-load-generator --
+-- ---------------------------------------
+
+project "mosaic-load-generator"
+   targetname "mosaic-load-generator"
+   kind "ConsoleApp"
+
+   files { "ambassador/AmbassadorChannel.h"
+         , "ambassador/AmbassadorChannel.cc"
+         , "ambassador/LoadGenerator.cc"
+         , "src/util/ShmChannel.h"
+         , "src/util/ShmChannel.cc"
+         , "src/util/FrameCompression.h"
+         , "src/util/FrameCompression.cc"
+         , "src/util/ChannelStatistics.h"
+         , "src/util/ChannelStatistics.cc"
+         , PROTO_CC_PATH .. "/ClientServerChannelMessages.pb.h"
+         , PROTO_CC_PATH .. "/ClientServerChannelMessages.pb.cc"
+         }
+
+   includedirs { "/usr/include"
+               , "ambassador"
+               , "src/util"
+               , PROTO_CC_PATH
+               }
+
+   buildoptions { "-std=c++17" }
+   links { "protobuf", "pthread", "rt" }
+
+   configuration "with-lz4"
+      defines { "WITH_LZ4" }
+      links { "lz4" }
+
+   filter "configurations:Debug"
+      defines { "DEBUG" }
+      symbols "On"
+
+   filter "configurations:Release"
+      defines { "NDEBUG" }
+      optimize "On"
+
+-- ----------------------------------------
+-- target: bin/mosaic-flight-recorder --
+-- ----------------------------------------
+
+project "mosaic-flight-recorder"
+   targetname "mosaic-flight-recorder"
+   kind "ConsoleApp"
+
+   files { "ambassador/FlightRecorderDecoder.cc"
+         , "src/util/FlightRecorder.h"
+         , "src/util/FlightRecorder.cc"
+         , "src/util/ChannelStatistics.h"
+         , "src/util/ChannelStatistics.cc"
+         , PROTO_CC_PATH .. "/ClientServerChannelMessages.pb.h"
+         , PROTO_CC_PATH .. "/ClientServerChannelMessages.pb.cc"
+         }
+
+   includedirs { "/usr/include"
+               , "src/util"
+               , PROTO_CC_PATH
+               }
+
+   buildoptions { "-std=c++17" }
+   links { "protobuf", "pthread" }
+
+   filter "configurations:Debug"
+      defines { "DEBUG" }
+      symbols "On"
+
+   filter "configurations:Release"
+      defines { "NDEBUG" }
+      optimize "On"
+
+-- ---------------------------------------
+-- target: bin/wire-format-benchmark --
+-- ---------------------------------------
+
+if _OPTIONS["with-benchmarks"] then
+
+  project "wire-format-benchmark"
+     targetname "wire-format-benchmark"
+     kind "ConsoleApp"
+
+     files { "benchmark/WireFormatBenchmark.cc"
+           , "src/util/FlatMessages.h"
+           , "src/util/FlatMessages.cc"
+           , PROTO_CC_PATH .. "/ClientServerChannelMessages.pb.h"
+           , PROTO_CC_PATH .. "/ClientServerChannelMessages.pb.cc"
+           }
+
+     includedirs { "/usr/include"
+                 , "src/util"
+                 , PROTO_CC_PATH
+                 }
+
+     buildoptions { "-std=c++17" }
+     links { "protobuf", "benchmark", "pthread" }
+
+     filter "configurations:Debug"
+        defines { "DEBUG" }
+        symbols "On"
+
+     filter "configurations:Release"
+        defines { "NDEBUG" }
+        optimize "On"
+
+-- -------------------------------------
+-- target: bin/federate-benchmark --
+-- -------------------------------------
+
+  project "federate-benchmark"
+     targetname "federate-benchmark"
+     kind "ConsoleApp"
+
+     files { "benchmark/BenchmarkMain.cc"
+           , "benchmark/ChannelBenchmark.cc"
+           , "benchmark/SchedulerBenchmark.cc"
+           }
+
+     includedirs { "/usr/include"
+                 , "src"
+                 , "src/mgmt"
+                 , "src/msg"
+                 , "src/node"
+                 , "src/util"
+                 , PROTO_CC_PATH
+                 }
+
+     buildoptions { "-std=c++17" }
+     linkoptions { "-Wl,--no-as-needed,-rpath,'$$ORIGIN'" }
+
+     filter "configurations:Debug"
+        defines { "DEBUG" }
+        links { "INET_dbg"
+              , "omnetpp-federate-LIBRARY"
+              , "oppsim_dbg"
+              , "oppenvir_dbg"
+              , "oppcommon_dbg"
+              , "protobuf"
+              , "benchmark"
+              , "pthread"
+              , "dl"
+              }
+        libdirs { "bin/Debug", "/usr/lib" }
+        symbols "On"
+
+     filter "configurations:Release"
+        defines { "NDEBUG" }
+        links { "INET"
+              , "omnetpp-federate-LIBRARY"
+              , "oppsim"
+              , "oppenvir"
+              , "oppcommon"
+              , "protobuf"
+              , "benchmark"
+              , "pthread"
+              , "dl"
+              }
+        libdirs { "bin/Release", "/usr/lib" }
+        optimize "On"
+
+end
+
 if _ACTION == "clean" then
     os.rmdir("bin")
     os.rmdir("obj")
     os.rmdir("omnetpp-federate-BINARY.make");
     os.rmdir("omnetpp-federate-LIBRARY.make");
+    os.rmdir("mosaic-ambassador-stub.make");
+    os.rmdir("mosaic-load-generator.make");
+    os.rmdir("mosaic-flight-recorder.make");
+    os.rmdir("wire-format-benchmark.make");
+    os.rmdir("federate-benchmark.make");
 end
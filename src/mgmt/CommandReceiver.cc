@@ -0,0 +1,109 @@
+/*
+ * Copyright (c) 2020 Fraunhofer FOKUS and others. All rights reserved.
+ *
+ * Contact: mosaic@fokus.fraunhofer.de
+ *
+ * This class is developed for the MOSAIC-OMNeT++ coupling.
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License version 2 as
+ * published by the Free Software Foundation;
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+ *
+ */
+
+#include "CommandReceiver.h"
+
+#include "util/SpanTrace.h"
+
+namespace omnetpp_federate {
+
+CommandReceiver::CommandReceiver(ClientServerChannel *channel, size_t capacity)
+    : m_channel(channel), m_queue(capacity) {}
+
+CommandReceiver::~CommandReceiver() { stop(); }
+
+void CommandReceiver::start() {
+  m_thread = std::thread(&CommandReceiver::run, this);
+}
+
+void CommandReceiver::stop() {
+  if (!m_thread.joinable()) {
+    return;
+  }
+  if (!m_finished) {
+    m_channel->shutdownReceive();
+    m_queue.close();
+  }
+  m_thread.join();
+}
+
+void CommandReceiver::run() {
+  SpanTrace::setThreadName("receiver");
+  bool running = true;
+  while (running) {
+    const CMD command = m_channel->readCommand();
+    if (command == CMD_COMMAND_BATCH && m_channel->readCommandBatch() == 0) {
+      CMD entry;
+      while (running && (entry = m_channel->readBatchCommand()) != CMD_UNDEF) {
+        running = receive(entry);
+      }
+    } else {
+      running = receive(command);
+    }
+  }
+  m_finished = true;
+}
+
+/**
+ * Reads the message of a command into the next free slot of the queue.
+ * @return false if the thread has to end
+ */
+bool CommandReceiver::receive(CMD command) {
+  ReceivedCommand *received = m_queue.beginPush();
+  if (received == nullptr) {
+    return false;
+  }
+  received->command = command;
+  received->status = 0;
+  const SpanTrace::Scope span("decode", "channel");
+  bool known = true;
+  switch (command) {
+  case CMD_UPDATE_NODE:
+  case CMD_UPDATE_NODE_PACKED:
+    received->status = m_channel->readUpdateNode(received->update_node);
+    break;
+  case CMD_MSG_SEND:
+    received->status = m_channel->readSendMessage(received->send_message);
+    break;
+  case CMD_CONF_RADIO:
+    received->status =
+        m_channel->readConfigurationMessage(received->config_message);
+    break;
+  case CMD_ADVANCE_TIME:
+    received->time = m_channel->readTimeMessage();
+    break;
+  case CMD_SHUT_DOWN:
+    break;
+  case CMD_COMMAND_BATCH:
+    // only queued if the batch could not be read
+    received->status = 1;
+    break;
+  default:
+    known = false;
+    break;
+  }
+  m_queue.commitPush();
+  // nothing follows a shutdown, the Ambassador may close the channel
+  return known && command != CMD_SHUT_DOWN;
+}
+
+} // namespace omnetpp_federate
@@ -0,0 +1,87 @@
+/*
+ * Copyright (c) 2020 Fraunhofer FOKUS and others. All rights reserved.
+ *
+ * Contact: mosaic@fokus.fraunhofer.de
+ *
+ * This class is developed for the MOSAIC-OMNeT++ coupling.
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License version 2 as
+ * published by the Free Software Foundation;
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+ *
+ */
+
+#ifndef COMMANDRECEIVER_H_
+#define COMMANDRECEIVER_H_
+
+#include <atomic>
+#include <thread>
+
+#include "util/ClientServerChannel.h"
+#include "util/SpscRing.h"
+
+namespace omnetpp_federate {
+using namespace ClientServerChannelSpace;
+
+/** A command read by the CommandReceiver, slots of the queue are reused. */
+struct ReceivedCommand {
+  CMD command = CMD_UNDEF;
+  /** result of the read method, not 0 if the command could not be read */
+  int status = 0;
+  /** new maximum time of CMD_ADVANCE_TIME */
+  int64_t time = 0;
+  CSC_update_node_return update_node;
+  CSC_send_message send_message;
+  CSC_config_message config_message;
+};
+
+/**
+ * Reads and decodes the commands of the Ambassador on its own thread, so that
+ * network I/O and decoding overlap with the execution of events. Commands of a
+ * CMD_COMMAND_BATCH are queued one by one. The channel must not acknowledge
+ * commands, as the simulation thread writes to the other channel only.
+ *
+ * The thread ends after CMD_SHUT_DOWN or a command it does not know, including
+ * CMD_UNDEF if the channel failed, which is queued as the last command.
+ */
+class CommandReceiver {
+
+public:
+  CommandReceiver(ClientServerChannel *channel, size_t capacity);
+
+  /** Stops the thread, see stop(). */
+  virtual ~CommandReceiver();
+
+  virtual void start();
+
+  /** Stops reading, the channel can not be read afterwards. */
+  virtual void stop();
+
+  /** Next command, blocks until it is decoded. */
+  ReceivedCommand &front() { return m_queue.front(); }
+
+  /** Releases the command returned by front(). */
+  void pop() { m_queue.pop(); }
+
+private:
+  ClientServerChannel *m_channel;
+  SpscRing<ReceivedCommand> m_queue;
+  std::thread m_thread;
+  std::atomic<bool> m_finished{false};
+
+  void run();
+  bool receive(CMD command);
+};
+
+} // namespace omnetpp_federate
+
+#endif /* COMMANDRECEIVER_H_ */
@@ -21,10 +21,18 @@
  */
 
 #include "MosaicEventScheduler.h"
+#include "CommandReceiver.h"
+#include "ReportWriter.h"
 
 #include <algorithm>
 #include <chrono>
+#include <cmath>
+#include <cstring>
+#include <filesystem>
+#include <fstream>
 #include <iostream>
+#include <pthread.h>
+#include <sched.h>
 #include <signal.h>
 #include <sstream>
 #include <unistd.h>
@@ -33,6 +41,9 @@
 #include <omnetpp/clog.h>
 
 #include "msg/MosaicAppPacket_m.h"
+#include "util/FlightRecorder.h"
+#include "util/FrameCompression.h"
+#include "util/SpanTrace.h"
 #include "msg/MosaicCommunicationCmd_m.h"
 #include "msg/MosaicConfigurationCmd_m.h"
 
@@ -66,6 +77,20 @@ using namespace omnetpp;
 /** Reference to scenario management module */
 static cModule *mgmt;
 
+/** Synchronization overhead per reporting interval, see the NED file */
+static const simsignal_t syncWaitTimeSignal =
+    cComponent::registerSignal("syncWaitTime");
+static const simsignal_t syncEventTimeSignal =
+    cComponent::registerSignal("syncEventTime");
+static const simsignal_t syncGrantsSignal =
+    cComponent::registerSignal("syncGrants");
+static const simsignal_t syncNextEventsSignal =
+    cComponent::registerSignal("syncNextEvents");
+static const simsignal_t syncEventsSignal =
+    cComponent::registerSignal("syncEvents");
+static const simsignal_t syncEmptyGrantsSignal =
+    cComponent::registerSignal("syncEmptyGrants");
+
 Register_Class(MosaicEventScheduler);
 
 Register_GlobalConfigOption(CFGID_MOSAICEVENTSCHEDULER_DEBUG,
@@ -84,6 +109,196 @@ Register_GlobalConfigOption(CFGID_MOSAICCMD_PORT, "mosaiccmd-port", CFG_INT,
                             "0",
                             "Port for command channel socket from mosaic.");
 
+Register_GlobalConfigOption(
+    CFGID_MOSAICEVENTSCHEDULER_TRANSPORT, "mosaiceventscheduler-transport",
+    CFG_STRING, "tcp",
+    "Transport of both channels to mosaic: tcp, unix for Unix domain sockets "
+    "or shm for shared memory rings if mosaic runs on the same host. replay "
+    "reads the commands from mosaiceventscheduler-replay-file instead.");
+
+Register_GlobalConfigOption(
+    CFGID_MOSAICEVENTSCHEDULER_REPLAY_FILE, "mosaiceventscheduler-replay-file",
+    CFG_FILENAME, "",
+    "Trace of mosaiceventscheduler-record-file replayed by the replay "
+    "transport.");
+
+Register_GlobalConfigOption(
+    CFGID_MOSAICEVENTSCHEDULER_REPLAY_SPEED,
+    "mosaiceventscheduler-replay-speed", CFG_DOUBLE, "0",
+    "Factor of the recorded pace the commands are replayed with, 0 replays "
+    "them as fast as possible.");
+
+Register_GlobalConfigOption(
+    CFGID_MOSAICEVENTSCHEDULER_RECORD_FILE, "mosaiceventscheduler-record-file",
+    CFG_FILENAME, "",
+    "Record the commands received from mosaic with their arrival time to "
+    "this trace file, empty for none.");
+
+Register_GlobalConfigOption(
+    CFGID_MOSAICEVENTSCHEDULER_SOCKET_PATH, "mosaiceventscheduler-socket-path",
+    CFG_STRING, "/tmp/omnetpp-federate",
+    "Path prefix of the Unix domain sockets, the port number is appended.");
+
+Register_GlobalConfigOption(
+    CFGID_MOSAICEVENTSCHEDULER_SHM_NAME, "mosaiceventscheduler-shm-name",
+    CFG_STRING, "/omnetpp-federate",
+    "Name prefix of the shared memory segments, the port number is appended.");
+
+Register_GlobalConfigOption(
+    CFGID_MOSAICEVENTSCHEDULER_RECEIVE_BATCH,
+    "mosaiceventscheduler-receive-batch", CFG_BOOL, "true",
+    "Offer mosaic to report all receptions of a time advance in one batch.");
+
+Register_GlobalConfigOption(
+    CFGID_MOSAICEVENTSCHEDULER_COMMAND_BATCH,
+    "mosaiceventscheduler-command-batch", CFG_BOOL, "true",
+    "Offer mosaic to send several commands in one acknowledged batch.");
+
+Register_GlobalConfigOption(
+    CFGID_MOSAICEVENTSCHEDULER_PIPELINED, "mosaiceventscheduler-pipelined",
+    CFG_BOOL, "true",
+    "Offer mosaic to stream commands without waiting for a SUCCESS of each.");
+
+Register_GlobalConfigOption(
+    CFGID_MOSAICEVENTSCHEDULER_PACKED_UPDATE,
+    "mosaiceventscheduler-packed-update", CFG_BOOL, "true",
+    "Offer mosaic to send node positions as packed arrays.");
+
+Register_GlobalConfigOption(
+    CFGID_MOSAICEVENTSCHEDULER_DELTA_UPDATE,
+    "mosaiceventscheduler-delta-update", CFG_BOOL, "true",
+    "Offer mosaic to omit nodes from position updates that did not move by "
+    "more than mosaiceventscheduler-move-epsilon.");
+
+Register_GlobalConfigOptionU(
+    CFGID_MOSAICEVENTSCHEDULER_MOVE_EPSILON,
+    "mosaiceventscheduler-move-epsilon", "m", "0m",
+    "Position updates of nodes closer than this distance to their last applied "
+    "position are skipped, 0 applies all updates.");
+
+Register_GlobalConfigOption(
+    CFGID_MOSAICEVENTSCHEDULER_INTEREST, "mosaiceventscheduler-interest",
+    CFG_BOOL, "true",
+    "Offer mosaic to report which nodes need position updates, nodes without "
+    "an active radio do not.");
+
+Register_GlobalConfigOption(
+    CFGID_MOSAICEVENTSCHEDULER_INTEREST_FILTER,
+    "mosaiceventscheduler-interest-filter", CFG_BOOL, "false",
+    "Skip position updates of nodes without an active radio, also if mosaic "
+    "does not support mobility interest. Their position is only refreshed by "
+    "the next update after a radio is turned on.");
+
+Register_GlobalConfigOption(
+    CFGID_MOSAICEVENTSCHEDULER_COMPRESSION, "mosaiceventscheduler-compression",
+    CFG_BOOL, "true",
+    "Offer mosaic to compress large frames with LZ4, only if the federate was "
+    "built with LZ4 support.");
+
+Register_GlobalConfigOption(
+    CFGID_MOSAICEVENTSCHEDULER_COMPRESSION_THRESHOLD,
+    "mosaiceventscheduler-compression-threshold", CFG_INT, "1024",
+    "Smallest message in bytes that is compressed when sent to mosaic.");
+
+Register_GlobalConfigOption(
+    CFGID_MOSAICEVENTSCHEDULER_FLAT_MESSAGES,
+    "mosaiceventscheduler-flat-messages", CFG_BOOL, "true",
+    "Offer mosaic to send node updates, sent and received messages in a fixed "
+    "little-endian layout that is read without protobuf parsing.");
+
+Register_GlobalConfigOption(
+    CFGID_MOSAICEVENTSCHEDULER_RECEIVER_THREAD,
+    "mosaiceventscheduler-receiver-thread", CFG_BOOL, "false",
+    "Read and decode the commands of mosaic on a second thread while events "
+    "are executed, only used if mosaic selected pipelined commands.");
+
+Register_GlobalConfigOption(
+    CFGID_MOSAICEVENTSCHEDULER_WRITER_THREAD,
+    "mosaiceventscheduler-writer-thread", CFG_BOOL, "false",
+    "Serialize and send the reports to mosaic on a second thread, so that a "
+    "slow mosaic does not stall the execution of events.");
+
+Register_GlobalConfigOptionU(
+    CFGID_MOSAICEVENTSCHEDULER_BUSY_POLL, "mosaiceventscheduler-busy-poll",
+    "s", "0s",
+    "Poll the channels without blocking for this time before a read blocks. "
+    "Lowers the latency of each time advance at the cost of a busy CPU.");
+
+Register_GlobalConfigOption(
+    CFGID_MOSAICEVENTSCHEDULER_TCP_NODELAY, "mosaiceventscheduler-tcp-nodelay",
+    CFG_BOOL, "true",
+    "Disable Nagle's algorithm on the TCP sockets to mosaic.");
+
+Register_GlobalConfigOptionU(
+    CFGID_MOSAICEVENTSCHEDULER_SOCKET_RECEIVE_BUFFER,
+    "mosaiceventscheduler-socket-receive-buffer", "B", "0B",
+    "SO_RCVBUF of the sockets to mosaic, 0 keeps the system default.");
+
+Register_GlobalConfigOptionU(
+    CFGID_MOSAICEVENTSCHEDULER_SOCKET_SEND_BUFFER,
+    "mosaiceventscheduler-socket-send-buffer", "B", "0B",
+    "SO_SNDBUF of the sockets to mosaic, 0 keeps the system default.");
+
+Register_GlobalConfigOption(
+    CFGID_MOSAICEVENTSCHEDULER_CPU_AFFINITY,
+    "mosaiceventscheduler-cpu-affinity", CFG_INT, "-1",
+    "Pin the simulation thread to this CPU, -1 does not pin it. Receiver and "
+    "writer threads may run on all CPUs.");
+
+Register_GlobalConfigOption(
+    CFGID_MOSAICEVENTSCHEDULER_CHANNEL_STATISTICS,
+    "mosaiceventscheduler-channel-statistics", CFG_BOOL, "true",
+    "Record messages, bytes, decode and blocking times per command of both "
+    "channels as scalars and histograms of the scenario manager.");
+
+Register_GlobalConfigOption(
+    CFGID_MOSAICEVENTSCHEDULER_CHANNEL_STATISTICS_JSON,
+    "mosaiceventscheduler-channel-statistics-json", CFG_FILENAME, "",
+    "Also write the channel statistics with all histogram buckets to this "
+    "JSON file, empty for none.");
+
+Register_GlobalConfigOption(
+    CFGID_MOSAICEVENTSCHEDULER_FLIGHT_RECORDER_SIZE,
+    "mosaiceventscheduler-flight-recorder-size", CFG_INT, "65536",
+    "Number of frames and scheduler state changes kept in memory by the "
+    "flight recorder, 32 bytes each, 0 disables it.");
+
+Register_GlobalConfigOption(
+    CFGID_MOSAICEVENTSCHEDULER_FLIGHT_RECORDER_FILE,
+    "mosaiceventscheduler-flight-recorder-file", CFG_FILENAME,
+    "${resultdir}/flight-recorder.bin",
+    "The flight recorder is written to this file once, on a failure of the "
+    "coupling or else at the end of the run, on SIGUSR1 to this file with the "
+    "suffix .signal.");
+
+Register_GlobalConfigOption(
+    CFGID_MOSAICEVENTSCHEDULER_TRACE_FILE, "mosaiceventscheduler-trace-file",
+    CFG_FILENAME, "",
+    "Keep wall-clock spans of the synchronization with mosaic, decoding, FES "
+    "inserts, event execution per module class and reports in memory and "
+    "write them to this Chrome trace JSON file at the end of the run, empty "
+    "disables tracing.");
+
+Register_GlobalConfigOption(
+    CFGID_MOSAICEVENTSCHEDULER_TRACE_MAX_SPANS,
+    "mosaiceventscheduler-trace-max-spans", CFG_INT, "1048576",
+    "Number of spans kept per thread while tracing, 32 bytes each. Later spans "
+    "are dropped and counted.");
+
+Register_GlobalConfigOption(
+    CFGID_MOSAICEVENTSCHEDULER_SYNC_STATISTICS,
+    "mosaiceventscheduler-sync-statistics", CFG_BOOL, "true",
+    "Record the wall time waiting for mosaic and executing events, the time "
+    "advances granted, NEXT_EVENT requests, events per grant and empty grants "
+    "as scalars and histograms of the scenario manager.");
+
+Register_GlobalConfigOptionU(
+    CFGID_MOSAICEVENTSCHEDULER_SYNC_STATISTICS_INTERVAL,
+    "mosaiceventscheduler-sync-statistics-interval", "s", "0s",
+    "Also emit the synchronization statistics of each interval of this "
+    "simulation time as signals of the scenario manager, 0 only records them "
+    "for the whole run.");
+
 void MosaicEventScheduler::startRun() {
   std::cout << "MosaicEventScheduler started" << endl;
 
@@ -100,8 +315,118 @@ void MosaicEventScheduler::startRun() {
       CFGID_MOSAICEVENTSCHEDULER_PORT);
   m_cmdport = cSimulation::getActiveEnvir()->getConfig()->getAsInt(
       CFGID_MOSAICCMD_PORT);
+  m_transport = cSimulation::getActiveEnvir()->getConfig()->getAsString(
+      CFGID_MOSAICEVENTSCHEDULER_TRANSPORT);
+  m_socketPath = cSimulation::getActiveEnvir()->getConfig()->getAsString(
+      CFGID_MOSAICEVENTSCHEDULER_SOCKET_PATH);
+  m_shmName = cSimulation::getActiveEnvir()->getConfig()->getAsString(
+      CFGID_MOSAICEVENTSCHEDULER_SHM_NAME);
+  if (m_transport != "tcp" && m_transport != "unix" && m_transport != "shm" &&
+      m_transport != "replay") {
+    throw cRuntimeError("MosaicEventScheduler unknown transport \"%s\"",
+                        m_transport.c_str());
+  }
+  m_replayFile = cSimulation::getActiveEnvir()->getConfig()->getAsFilename(
+      CFGID_MOSAICEVENTSCHEDULER_REPLAY_FILE);
+  m_replaySpeed = cSimulation::getActiveEnvir()->getConfig()->getAsDouble(
+      CFGID_MOSAICEVENTSCHEDULER_REPLAY_SPEED);
+  m_recordFile = cSimulation::getActiveEnvir()->getConfig()->getAsFilename(
+      CFGID_MOSAICEVENTSCHEDULER_RECORD_FILE);
+  if (m_transport == "replay" && m_replayFile.empty()) {
+    throw cRuntimeError("MosaicEventScheduler replay transport requires "
+                        "mosaiceventscheduler-replay-file");
+  }
+  m_offeredCapabilities = 0;
+  if (cSimulation::getActiveEnvir()->getConfig()->getAsBool(
+          CFGID_MOSAICEVENTSCHEDULER_RECEIVE_BATCH)) {
+    m_offeredCapabilities |= CAP_RECEIVE_BATCH;
+  }
+  if (cSimulation::getActiveEnvir()->getConfig()->getAsBool(
+          CFGID_MOSAICEVENTSCHEDULER_COMMAND_BATCH)) {
+    m_offeredCapabilities |= CAP_COMMAND_BATCH;
+  }
+  if (cSimulation::getActiveEnvir()->getConfig()->getAsBool(
+          CFGID_MOSAICEVENTSCHEDULER_PIPELINED)) {
+    m_offeredCapabilities |= CAP_PIPELINED;
+  }
+  if (cSimulation::getActiveEnvir()->getConfig()->getAsBool(
+          CFGID_MOSAICEVENTSCHEDULER_PACKED_UPDATE)) {
+    m_offeredCapabilities |= CAP_PACKED_UPDATE;
+  }
+  if (cSimulation::getActiveEnvir()->getConfig()->getAsBool(
+          CFGID_MOSAICEVENTSCHEDULER_DELTA_UPDATE)) {
+    m_offeredCapabilities |= CAP_DELTA_UPDATE;
+  }
+  if (cSimulation::getActiveEnvir()->getConfig()->getAsBool(
+          CFGID_MOSAICEVENTSCHEDULER_INTEREST)) {
+    m_offeredCapabilities |= CAP_INTEREST;
+  }
+  if (cSimulation::getActiveEnvir()->getConfig()->getAsBool(
+          CFGID_MOSAICEVENTSCHEDULER_COMPRESSION) &&
+      FrameCompression::available()) {
+    m_offeredCapabilities |= CAP_COMPRESSION;
+  }
+  if (cSimulation::getActiveEnvir()->getConfig()->getAsBool(
+          CFGID_MOSAICEVENTSCHEDULER_FLAT_MESSAGES)) {
+    m_offeredCapabilities |= CAP_FLAT_MESSAGES;
+  }
+  m_compressionThreshold = cSimulation::getActiveEnvir()->getConfig()->getAsInt(
+      CFGID_MOSAICEVENTSCHEDULER_COMPRESSION_THRESHOLD);
+  m_moveEpsilon = cSimulation::getActiveEnvir()->getConfig()->getAsDouble(
+      CFGID_MOSAICEVENTSCHEDULER_MOVE_EPSILON);
+  m_interestFilter = cSimulation::getActiveEnvir()->getConfig()->getAsBool(
+      CFGID_MOSAICEVENTSCHEDULER_INTEREST_FILTER);
+  m_receiverThread = cSimulation::getActiveEnvir()->getConfig()->getAsBool(
+      CFGID_MOSAICEVENTSCHEDULER_RECEIVER_THREAD);
+  m_writerThread = cSimulation::getActiveEnvir()->getConfig()->getAsBool(
+      CFGID_MOSAICEVENTSCHEDULER_WRITER_THREAD);
+  m_busyPoll = std::chrono::nanoseconds(
+      std::llround(cSimulation::getActiveEnvir()->getConfig()->getAsDouble(
+                       CFGID_MOSAICEVENTSCHEDULER_BUSY_POLL) *
+                   1e9));
+  if (m_busyPoll.count() > 0 && sysconf(_SC_NPROCESSORS_ONLN) < 2) {
+    // polling only delays mosaic if both share a single CPU
+    EV_WARN << "MosaicEventScheduler busy polling disabled on a single CPU"
+            << endl;
+    m_busyPoll = std::chrono::nanoseconds(0);
+  }
+  m_tcpNoDelay = cSimulation::getActiveEnvir()->getConfig()->getAsBool(
+      CFGID_MOSAICEVENTSCHEDULER_TCP_NODELAY);
+  m_socketReceiveBuffer =
+      cSimulation::getActiveEnvir()->getConfig()->getAsDouble(
+          CFGID_MOSAICEVENTSCHEDULER_SOCKET_RECEIVE_BUFFER);
+  m_socketSendBuffer = cSimulation::getActiveEnvir()->getConfig()->getAsDouble(
+      CFGID_MOSAICEVENTSCHEDULER_SOCKET_SEND_BUFFER);
+  const int cpu = cSimulation::getActiveEnvir()->getConfig()->getAsInt(
+      CFGID_MOSAICEVENTSCHEDULER_CPU_AFFINITY);
+  m_channelStatistics = cSimulation::getActiveEnvir()->getConfig()->getAsBool(
+      CFGID_MOSAICEVENTSCHEDULER_CHANNEL_STATISTICS);
+  m_channelStatisticsJson =
+      cSimulation::getActiveEnvir()->getConfig()->getAsFilename(
+          CFGID_MOSAICEVENTSCHEDULER_CHANNEL_STATISTICS_JSON);
+  startFlightRecorder();
+  m_traceFile = cSimulation::getActiveEnvir()->getConfig()->getAsFilename(
+      CFGID_MOSAICEVENTSCHEDULER_TRACE_FILE);
+  if (!m_traceFile.empty()) {
+    const int maxSpans = cSimulation::getActiveEnvir()->getConfig()->getAsInt(
+        CFGID_MOSAICEVENTSCHEDULER_TRACE_MAX_SPANS);
+    SpanTrace::enable(std::max(maxSpans, 0));
+    SpanTrace::setThreadName("simulation");
+  }
+  m_syncStatistics = cSimulation::getActiveEnvir()->getConfig()->getAsBool(
+      CFGID_MOSAICEVENTSCHEDULER_SYNC_STATISTICS);
+  m_syncReportInterval =
+      cSimulation::getActiveEnvir()->getConfig()->getAsDouble(
+          CFGID_MOSAICEVENTSCHEDULER_SYNC_STATISTICS_INTERVAL);
 
   connectToAmbassador();
+  m_replayStart = std::chrono::steady_clock::now();
+  m_syncStart = ChannelStatistics::now();
+  m_nextSyncReport = m_startTime + m_syncReportInterval;
+  // after the receiver and writer threads started, they must not inherit it
+  if (cpu >= 0) {
+    pinSimulationThread(cpu);
+  }
 }
 
 void MosaicEventScheduler::endRun() {
@@ -110,8 +435,42 @@ void MosaicEventScheduler::endRun() {
     // toggle the once flag
     once = true;
 
+    // the thread reads the channel until it is stopped
+    delete m_commandReceiver;
+    m_commandReceiver = nullptr;
+    // sends the reports that are still queued
+    delete m_reportWriter;
+    m_reportWriter = nullptr;
+    if (m_capabilities & CAP_COMPRESSION) {
+      logCompression(m_federateAmbassadorChannel, true);
+      logCompression(m_ambassadorFederateChannel, false);
+    }
+    if (m_channelStatistics) {
+      recordChannelStatistics(m_federateAmbassadorChannel, "outChannel");
+      recordChannelStatistics(m_ambassadorFederateChannel, "cmdChannel");
+      writeChannelStatisticsJson();
+    }
     delete m_ambassadorFederateChannel;
     delete m_federateAmbassadorChannel;
+    dumpFlightRecorder();
+    endEvent();
+    if (m_syncStatistics) {
+      recordSyncStatistics();
+    }
+    writeSpanTrace();
+
+    if (m_transport == "replay") {
+      EV_INFO << "MosaicEventScheduler replayed " << m_replayFile << " in "
+              << std::chrono::duration<double>(
+                     std::chrono::steady_clock::now() - m_replayStart)
+                     .count()
+              << "s" << endl;
+    }
+
+    if (m_moveEpsilon > 0 || m_interestFilter) {
+      EV_INFO << "MosaicEventScheduler skipped " << m_numSkippedMoves
+              << " position updates" << endl;
+    }
 
     EV_DEBUG << "MosaicEventScheduler ended" << endl;
   }
@@ -124,23 +483,32 @@ void MosaicEventScheduler::endRun() {
  * 2 - Ambassador connects to port A
  * 3 - Federate opens another port B for reading (ambassadorFederateChannel)
  * 4 - Federate sends CMD_INIT message over federateAmbassadorChannel
- * 5 - Federate sends port B over federateAmbassadorChannel
+ * 5 - Federate sends port B and the offered capabilities over
+ *     federateAmbassadorChannel
  * 6 - Ambassador connects to port B
  *  next steps in receiveInteractions-Thread
  *
+ * With mosaiceventscheduler-transport = unix, ports A and B are Unix domain
+ * sockets at "<mosaiceventscheduler-socket-path>-<port>" instead. With shm
+ * they are shared memory segments "<mosaiceventscheduler-shm-name>-<port>",
+ * the Ambassador "connects" by mapping the segment.
+ *
  * Second - Initialize the simulation with the ambassador
  *
- * 1 - Federate sends INIT-message containing start and endtime
- * 2 - Federate sets times and enables simulation
+ * 1 - Ambassador sends INIT-message containing start and endtime and the
+ *     capabilities it selected from the offered ones (none if it is unaware)
+ * 2 - Federate sets times and capabilities and enables simulation
  * 3 - Federate sends SUCCESS-message
  *
  * If no init-message can be read, the federate sends END-message to ambassador
  */
 void MosaicEventScheduler::connectToAmbassador() {
   m_federateAmbassadorChannel = new ClientServerChannel();
+  if (m_channelStatistics) {
+    m_federateAmbassadorChannel->enableStatistics();
+  }
 
-  const int actPort =
-      m_federateAmbassadorChannel->prepareConnection(m_host, m_port);
+  const int actPort = prepareChannel(m_federateAmbassadorChannel, m_port);
   if (actPort != m_port) {
     EV_DEBUG << "MosaicEventScheduler bound different port " << actPort
              << " instead of port " << m_port << endl;
@@ -150,18 +518,29 @@ void MosaicEventScheduler::connectToAmbassador() {
   const std::string outPortString =
       "MosaicEventScheduler connecting on OutPort=" + std::to_string(actPort) +
       " ";
-  usleep(1000000);
+  if (m_transport != "replay") {
+    usleep(1000000);
+  }
   std::cout << std::flush << outPortString << std::flush << endl;
   EV_DEBUG << outPortString << endl;
   m_federateAmbassadorChannel->connect();
 
   m_ambassadorFederateChannel = new ClientServerChannel();
-  const int actCmdPort =
-      m_ambassadorFederateChannel->prepareConnection(m_host, m_cmdport);
+  if (m_channelStatistics) {
+    m_ambassadorFederateChannel->enableStatistics();
+  }
+  const int actCmdPort = prepareChannel(m_ambassadorFederateChannel, m_cmdport);
+  if (!m_recordFile.empty() &&
+      !m_ambassadorFederateChannel->enableRecording(m_recordFile)) {
+    EV_WARN << "MosaicEventScheduler could not record to " << m_recordFile
+            << endl;
+  }
   std::cout << "MosaicEventScheduler connecting on CmdPort=" << actCmdPort
             << endl;
   m_federateAmbassadorChannel->writeCommand(CMD_INIT);
-  m_federateAmbassadorChannel->writePort(actCmdPort);
+  m_federateAmbassadorChannel->writePort(actCmdPort, m_offeredCapabilities,
+                                         m_moveEpsilon);
+  m_federateAmbassadorChannel->flush();
   m_ambassadorFederateChannel->connect();
 
   EV_DEBUG << "MosaicEventScheduler connected to Ambassador" << endl;
@@ -179,26 +558,408 @@ void MosaicEventScheduler::connectToAmbassador() {
              << endl;
 
     m_currentMaxSimTime = m_startTime;
+    m_capabilities = init_message.capabilities & m_offeredCapabilities;
+    if (m_transport == "replay") {
+      // the recorded selection was valid for the recording federate, frames
+      // of the trace are already decompressed
+      m_capabilities = init_message.capabilities & ~CAP_COMPRESSION;
+    }
+    EV_DEBUG << "MosaicEventScheduler capabilities: " << m_capabilities
+             << endl;
+    // in pipelined mode only ADVANCE_TIME synchronizes with the Ambassador
+    m_ambassadorFederateChannel->setAcknowledgeCommands(
+        !(m_capabilities & CAP_PIPELINED));
+    m_ambassadorFederateChannel->setFlatMessages(m_capabilities &
+                                                 CAP_FLAT_MESSAGES);
+    m_federateAmbassadorChannel->setFlatMessages(m_capabilities &
+                                                 CAP_FLAT_MESSAGES);
 
     EV_DEBUG << "MosaicEventScheduler successfully initialized" << endl;
     m_ambassadorFederateChannel->writeCommand(CMD_SUCCESS);
+    if (m_capabilities & CAP_COMPRESSION) {
+      // both directions switch to flagged frames after this SUCCESS
+      m_ambassadorFederateChannel->enableCompression(m_compressionThreshold);
+      m_federateAmbassadorChannel->enableCompression(m_compressionThreshold);
+    }
+    m_reportWriter = new ReportWriter(m_federateAmbassadorChannel,
+                                      m_capabilities & CAP_RECEIVE_BATCH);
+    if (m_writerThread) {
+      m_reportWriter->start(REPORT_QUEUE_SIZE);
+    }
+    if (m_receiverThread && (m_capabilities & CAP_PIPELINED)) {
+      // without acknowledgements only this thread writes to the channels
+      m_commandReceiver = new CommandReceiver(m_ambassadorFederateChannel,
+                                              RECEIVE_QUEUE_SIZE);
+      m_commandReceiver->start();
+    } else if (m_receiverThread) {
+      EV_WARN << "MosaicEventScheduler receiver thread requires pipelined "
+                 "commands, reading on the simulation thread"
+              << endl;
+    }
   } else {
     m_ambassadorFederateChannel->writeCommand(CMD_END);
-    cRuntimeError("MosaicEventScheduler FAILURE (unexpected command %d)",
-                  command);
+    m_ambassadorFederateChannel->flush();
+    FlightRecorder::record(FLIGHT_FAILURE, command, 0, 0);
+    dumpFlightRecorder();
+    throw cRuntimeError(
+        "MosaicEventScheduler FAILURE (unexpected command %d)", command);
+  }
+}
+
+/**
+ * Logs the compression counters of one channel, sent frames are compressed by
+ * the federate and received frames decompressed.
+ */
+void MosaicEventScheduler::logCompression(const ClientServerChannel *channel,
+                                          bool sent) {
+  const FrameCompression *compression = channel->getCompression();
+  if (compression == nullptr) {
+    return;
+  }
+  const FrameCompression::Statistics &stats = compression->getStatistics();
+  const uint64_t frames = sent ? stats.frames_written : stats.frames_read;
+  const uint64_t compressed =
+      sent ? stats.frames_compressed : stats.frames_decompressed;
+  const uint64_t original =
+      sent ? stats.compress_bytes_in : stats.decompress_bytes_out;
+  const uint64_t reduced =
+      sent ? stats.compress_bytes_out : stats.decompress_bytes_in;
+  EV_INFO << "MosaicEventScheduler " << (sent ? "sent " : "received ")
+          << compressed << " of "
+          << frames << " frames compressed, " << original << " -> " << reduced
+          << " bytes (ratio " << (reduced > 0 ? double(original) / reduced : 0)
+          << ") in "
+          << (sent ? stats.compress_seconds : stats.decompress_seconds) << "s"
+          << endl;
+}
+
+/**
+ * Records the statistics of a channel as results of the scenario manager,
+ * named "<channel>.<command>.<counter>".
+ */
+void MosaicEventScheduler::recordChannelStatistics(
+    const ClientServerChannel *channel, const std::string &name) {
+  const ChannelStatistics *statistics = channel->getStatistics();
+  if (statistics == nullptr || mgmt == nullptr) {
+    return;
+  }
+  for (int command = -1; command <= ChannelStatistics::MAX_COMMAND;
+       command++) {
+    const CommandStatistics *counters = statistics->find(command);
+    if (counters == nullptr) {
+      continue;
+    }
+    const std::string prefix =
+        name + "." + ChannelStatistics::commandName(command);
+    mgmt->recordScalar((prefix + ".received").c_str(), counters->received);
+    mgmt->recordScalar((prefix + ".sent").c_str(), counters->sent);
+    mgmt->recordScalar((prefix + ".bytesIn").c_str(), counters->bytes_in, "B");
+    mgmt->recordScalar((prefix + ".bytesOut").c_str(), counters->bytes_out,
+                       "B");
+    recordLatencyHistogram(prefix + ".decode", counters->decode_ns);
+    recordLatencyHistogram(prefix + ".wait", counters->wait_ns);
+  }
+  mgmt->recordScalar((name + ".flushedBytes").c_str(),
+                     statistics->getFlushedBytes(), "B");
+  recordLatencyHistogram(name + ".flush", statistics->getFlushHistogram());
+}
+
+/**
+ * Records a histogram in seconds with the buckets of the LatencyHistogram as
+ * bins, and its median and 99th percentile as scalars.
+ */
+void MosaicEventScheduler::recordLatencyHistogram(
+    const std::string &name, const LatencyHistogram &histogram, double scale,
+    const char *unit) {
+  if (histogram.getCount() == 0) {
+    return;
+  }
+  int first = LatencyHistogram::NUM_BUCKETS;
+  int last = 0;
+  for (int bucket = 0; bucket < LatencyHistogram::NUM_BUCKETS; bucket++) {
+    if (histogram.getBucketCount(bucket) > 0) {
+      first = std::min(first, bucket);
+      last = bucket;
+    }
+  }
+  std::vector<double> edges;
+  for (int bucket = first; bucket <= last + 1; bucket++) {
+    edges.push_back(LatencyHistogram::bucketLowerBound(bucket) * scale);
+  }
+  cHistogram result(name.c_str(), nullptr, true);
+  result.setBinEdges(edges);
+  for (int bucket = first; bucket <= last; bucket++) {
+    if (histogram.getBucketCount(bucket) > 0) {
+      result.collectWeighted(LatencyHistogram::bucketLowerBound(bucket) * scale,
+                             histogram.getBucketCount(bucket));
+    }
+  }
+  mgmt->recordStatistic(&result, unit);
+  mgmt->recordScalar((name + ":p50").c_str(),
+                     histogram.getPercentile(50) * scale, unit);
+  mgmt->recordScalar((name + ":p99").c_str(),
+                     histogram.getPercentile(99) * scale, unit);
+}
+
+void MosaicEventScheduler::writeChannelStatisticsJson() {
+  if (m_channelStatisticsJson.empty()) {
+    return;
+  }
+  std::ofstream out(m_channelStatisticsJson);
+  const char *separator = "{";
+  for (const ClientServerChannel *channel :
+       {m_federateAmbassadorChannel, m_ambassadorFederateChannel}) {
+    out << separator << "\""
+        << (channel == m_federateAmbassadorChannel ? "outChannel"
+                                                   : "cmdChannel")
+        << "\": ";
+    if (channel->getStatistics() != nullptr) {
+      channel->getStatistics()->writeJson(out);
+    } else {
+      out << "null";
+    }
+    separator = ",\n";
+  }
+  out << "}" << std::endl;
+  if (!out) {
+    EV_WARN << "MosaicEventScheduler could not write "
+            << m_channelStatisticsJson << endl;
+  }
+}
+
+/**
+ * Allocates the ring of the flight recorder and dumps it on SIGUSR1, so that
+ * a stalled coupling can be inspected while it blocks.
+ */
+void MosaicEventScheduler::startFlightRecorder() {
+  const int size = cSimulation::getActiveEnvir()->getConfig()->getAsInt(
+      CFGID_MOSAICEVENTSCHEDULER_FLIGHT_RECORDER_SIZE);
+  const std::string file =
+      cSimulation::getActiveEnvir()->getConfig()->getAsFilename(
+          CFGID_MOSAICEVENTSCHEDULER_FLIGHT_RECORDER_FILE);
+  FlightRecorder::configure(std::max(size, 0), file);
+  m_flightRecorderDumped = false;
+  if (!FlightRecorder::enabled()) {
+    return;
+  }
+  // the result folder is only created with the first results
+  const std::filesystem::path folder =
+      std::filesystem::path(file).parent_path();
+  std::error_code error;
+  if (!folder.empty()) {
+    std::filesystem::create_directories(folder, error);
+  }
+  if (error || !FlightRecorder::dumpOnSignal(SIGUSR1)) {
+    EV_WARN << "MosaicEventScheduler flight recorder cannot be dumped to "
+            << file << endl;
+  }
+}
+
+/**
+ * Writes the spans kept since startRun, the receiver and writer threads have
+ * ended.
+ */
+void MosaicEventScheduler::writeSpanTrace() {
+  if (!SpanTrace::enabled()) {
+    return;
+  }
+  SpanTrace::disable();
+  if (SpanTrace::getDropped() > 0) {
+    EV_WARN << "MosaicEventScheduler trace dropped " << SpanTrace::getDropped()
+            << " spans" << endl;
+  }
+  if (SpanTrace::write(m_traceFile)) {
+    EV_INFO << "MosaicEventScheduler wrote the trace to " << m_traceFile
+            << endl;
+  }
+}
+
+/**
+ * Starts to measure an event returned to the simulation, it ends when the
+ * simulation asks for the next event. Spans of messages are named after the
+ * class of their arrival module.
+ */
+void MosaicEventScheduler::beginEvent(cEvent *event) {
+  if (m_syncStatistics) {
+    m_syncInterval.events++;
+    m_eventsInGrant++;
+  } else if (!SpanTrace::enabled()) {
+    return;
+  }
+  if (SpanTrace::enabled()) {
+    cModule *module = event->isMessage()
+                          ? static_cast<cMessage *>(event)->getArrivalModule()
+                          : nullptr;
+    m_eventSpanName =
+        module != nullptr ? module->getClassName() : event->getClassName();
+  }
+  m_eventStart = ChannelStatistics::now();
+}
+
+void MosaicEventScheduler::endEvent() {
+  if (m_eventStart == 0) {
+    return;
+  }
+  const uint64_t end = ChannelStatistics::now();
+  if (SpanTrace::enabled()) {
+    SpanTrace::add(m_eventSpanName, "event", m_eventStart, end);
+  }
+  if (m_syncStatistics) {
+    m_syncInterval.eventNs += end - m_eventStart;
+  }
+  m_eventStart = 0;
+}
+
+/**
+ * Adds the time since start, in ns of ChannelStatistics::now(), to the wait
+ * for the Ambassador.
+ */
+void MosaicEventScheduler::waitedForAmbassador(uint64_t start) {
+  if (start != 0) {
+    m_syncInterval.waitNs += ChannelStatistics::now() - start;
+  }
+}
+
+/**
+ * Emits the synchronization counters of the interval that just ended and adds
+ * them to the counters of the run.
+ */
+void MosaicEventScheduler::reportSyncInterval() {
+  if (mgmt != nullptr && m_syncReportInterval > 0) {
+    mgmt->emit(syncWaitTimeSignal, m_syncInterval.waitNs * 1e-9);
+    mgmt->emit(syncEventTimeSignal, m_syncInterval.eventNs * 1e-9);
+    mgmt->emit(syncGrantsSignal, m_syncInterval.grants);
+    mgmt->emit(syncNextEventsSignal, m_syncInterval.nextEvents);
+    mgmt->emit(syncEventsSignal, m_syncInterval.events);
+    mgmt->emit(syncEmptyGrantsSignal, m_syncInterval.emptyGrants);
+  }
+  m_syncRun.waitNs += m_syncInterval.waitNs;
+  m_syncRun.eventNs += m_syncInterval.eventNs;
+  m_syncRun.grants += m_syncInterval.grants;
+  m_syncRun.nextEvents += m_syncInterval.nextEvents;
+  m_syncRun.events += m_syncInterval.events;
+  m_syncRun.emptyGrants += m_syncInterval.emptyGrants;
+  m_syncInterval = SyncCounters();
+}
+
+/**
+ * Records how the wall time of the run divides into waiting for the
+ * Ambassador, executing events and the rest (mainly processing commands), and
+ * how MOSAIC stepped the federate.
+ */
+void MosaicEventScheduler::recordSyncStatistics() {
+  reportSyncInterval();
+  if (mgmt == nullptr) {
+    return;
+  }
+  mgmt->recordScalar("sync.wallTime",
+                     (ChannelStatistics::now() - m_syncStart) * 1e-9, "s");
+  mgmt->recordScalar("sync.waitTime", m_syncRun.waitNs * 1e-9, "s");
+  mgmt->recordScalar("sync.eventTime", m_syncRun.eventNs * 1e-9, "s");
+  mgmt->recordScalar("sync.grants", m_syncRun.grants);
+  mgmt->recordScalar("sync.nextEvents", m_syncRun.nextEvents);
+  mgmt->recordScalar("sync.events", m_syncRun.events);
+  mgmt->recordScalar("sync.emptyGrants", m_syncRun.emptyGrants);
+  recordLatencyHistogram("sync.grantWindow", m_grantWindows);
+  recordLatencyHistogram("sync.eventsPerGrant", m_eventsPerGrant, 1, "");
+}
+
+/**
+ * Writes the flight recorder once per run, at the failure of the coupling or
+ * else at endRun.
+ */
+void MosaicEventScheduler::dumpFlightRecorder() {
+  if (!FlightRecorder::enabled() || m_flightRecorderDumped) {
+    return;
+  }
+  m_flightRecorderDumped = true;
+  if (FlightRecorder::dump()) {
+    EV_INFO << "MosaicEventScheduler wrote the flight recorder to "
+            << FlightRecorder::getPath() << endl;
+  } else {
+    EV_WARN << "MosaicEventScheduler could not write the flight recorder to "
+            << FlightRecorder::getPath() << " - " << strerror(errno) << endl;
   }
 }
 
+/**
+ * Binds the server socket of a channel using the configured transport.
+ *
+ * @return the port the Ambassador has to connect to (for Unix domain sockets
+ *         and shared memory the suffix of the socket path or segment name)
+ */
+int MosaicEventScheduler::prepareChannel(ClientServerChannel *channel,
+                                         int port) {
+  channel->setSocketOptions(m_tcpNoDelay, m_socketReceiveBuffer,
+                            m_socketSendBuffer);
+  int actPort;
+  if (m_transport == "unix") {
+    actPort = channel->prepareUnixConnection(m_socketPath, port);
+    std::cout << "MosaicEventScheduler listening on " << m_socketPath << "-"
+              << actPort << endl;
+  } else if (m_transport == "shm") {
+    actPort = channel->prepareShmConnection(m_shmName, port);
+    std::cout << "MosaicEventScheduler listening on shared memory "
+              << m_shmName << "-" << actPort << endl;
+  } else if (m_transport == "replay") {
+    // the commands are replayed, the output channel only drops the reports
+    const bool commands = channel != m_federateAmbassadorChannel;
+    if (!channel->prepareReplayConnection(commands ? m_replayFile : "",
+                                          m_replaySpeed)) {
+      throw cRuntimeError("MosaicEventScheduler could not replay %s",
+                          m_replayFile.c_str());
+    }
+    actPort = port;
+  } else {
+    actPort = channel->prepareConnection(m_host, port);
+  }
+  if (actPort == 0 && m_transport != "replay") {
+    throw cRuntimeError("MosaicEventScheduler could not listen for the "
+                        "Ambassador (transport %s, port %d)",
+                        m_transport.c_str(), port);
+  }
+  channel->setBusyPoll(m_busyPoll);
+  return actPort;
+}
+
+/**
+ * Binds the calling thread to one CPU, so that a busy polling simulation does
+ * not migrate between cores and keeps its caches.
+ */
+void MosaicEventScheduler::pinSimulationThread(int cpu) {
+  if (cpu >= CPU_SETSIZE) {
+    EV_WARN << "MosaicEventScheduler invalid CPU " << cpu << endl;
+    return;
+  }
+  cpu_set_t cpus;
+  CPU_ZERO(&cpus);
+  CPU_SET(cpu, &cpus);
+  const int error =
+      pthread_setaffinity_np(pthread_self(), sizeof(cpus), &cpus);
+  if (error != 0) {
+    EV_WARN << "MosaicEventScheduler could not pin the simulation to CPU "
+            << cpu << " - " << strerror(error) << endl;
+    return;
+  }
+  EV_INFO << "MosaicEventScheduler pinned the simulation to CPU " << cpu
+          << endl;
+}
+
 cEvent *MosaicEventScheduler::guessNextEvent() {
   return getSimulation()->getFES()->peekFirst();
 }
 
+/**
+ * The FES keeps events ordered by arrival time, priority and insertion order
+ * on insert, so it is not sorted again.
+ */
 void MosaicEventScheduler::putBackEvent(cEvent *event) {
+  const SpanTrace::Scope span("FES insert", "scheduler");
   getSimulation()->getFES()->insert(event);
-  getSimulation()->getFES()->sort();
 }
 
 cEvent *MosaicEventScheduler::takeNextEvent() {
+  endEvent();
   simtime_t nextTime = 0;
   simtime_t curTime = getSimulation()->getSimTime();
   curTime = curTime - curTime.remainderForUnit(SimTimeUnit::SIMTIME_NS);
@@ -214,6 +975,7 @@ cEvent *MosaicEventScheduler::takeNextEvent() {
       }
       EV_DEBUG << "MosaicEventScheduler The FES is empty. Time: " << curTime
                << endl;
+      m_syncInterval.emptyGrants++;
       endTimeAdvance(curTime);
       continue;
     }
@@ -232,6 +994,9 @@ cEvent *MosaicEventScheduler::takeNextEvent() {
 
   cEvent *event = getSimulation()->getFES()->removeFirst();
   if (event != NULL && !event->isStale()) {
+    FlightRecorder::setSimTime(
+        event->getArrivalTime().inUnit(SimTimeUnit::SIMTIME_NS));
+    beginEvent(event);
     return event;
   } else {
     return this->takeNextEvent();
@@ -243,32 +1008,90 @@ void MosaicEventScheduler::setMgmtModule(cModule *mod) { mgmt = mod; }
 void MosaicEventScheduler::reportNextEventToAmbassador(simtime_t nextSimTime) {
   EV_DEBUG << "MosaicEventScheduler request NEXT_EVENT: t=" << nextSimTime.str()
            << endl;
-  m_federateAmbassadorChannel->writeCommand(CMD_NEXT_EVENT);
-  m_federateAmbassadorChannel->writeTimeMessage(
-      nextSimTime.inUnit(SimTimeUnit::SIMTIME_NS));
+  reportCollected();
+  const int64_t nextTime = nextSimTime.inUnit(SimTimeUnit::SIMTIME_NS);
+  FlightRecorder::record(FLIGHT_NEXT_EVENT, CMD_NEXT_EVENT, 0, nextTime);
+  m_syncInterval.nextEvents++;
+  m_reportWriter->reportNextEvent(nextTime);
 }
 
 void MosaicEventScheduler::endTimeAdvance(simtime_t time) {
   EV_DEBUG << "MosaicEventScheduler END time advance: t=" << time.str() << endl;
-  m_federateAmbassadorChannel->writeCommand(CMD_END);
-  m_federateAmbassadorChannel->writeTimeMessage(
-      time.inUnit(SimTimeUnit::SIMTIME_NS));
+  reportCollected();
+  // flushes the channel, the reply of the Ambassador orders it before the
+  // next commands even if the writer thread sends it
+  const int64_t endTime = time.inUnit(SimTimeUnit::SIMTIME_NS);
+  FlightRecorder::record(FLIGHT_END_ADVANCE, CMD_END, 0, endTime);
+  if (m_syncStatistics) {
+    m_eventsPerGrant.record(m_eventsInGrant);
+    m_eventsInGrant = 0;
+  }
+  m_reportWriter->reportEnd(endTime);
   m_timeAdvancing = false;
 }
 
+/**
+ * Reports the changes collected during the time advance, they precede its
+ * NEXT_EVENT or END like the batch of receptions.
+ */
+void MosaicEventScheduler::reportCollected() {
+  if (m_changedInterest.empty()) {
+    return;
+  }
+  if (m_capabilities & CAP_INTEREST) {
+    // a node may have changed back and forth, only its final state is sent
+    std::sort(m_changedInterest.begin(), m_changedInterest.end());
+    m_changedInterest.erase(
+        std::unique(m_changedInterest.begin(), m_changedInterest.end()),
+        m_changedInterest.end());
+    m_subscribe.clear();
+    m_unsubscribe.clear();
+    for (const int nodeId : m_changedInterest) {
+      (m_mobilityInterest[nodeId] ? m_subscribe : m_unsubscribe)
+          .push_back(nodeId);
+    }
+    m_reportWriter->reportMobilityInterest(m_subscribe, m_unsubscribe);
+  }
+  m_changedInterest.clear();
+}
+
+void MosaicEventScheduler::setMobilityInterest(int nodeId, bool interested) {
+  if (nodeId < 0 || hasMobilityInterest(nodeId) == interested) {
+    return;
+  }
+  if (static_cast<size_t>(nodeId) >= m_mobilityInterest.size()) {
+    m_mobilityInterest.resize(nodeId + 1, true);
+  }
+  EV_DEBUG << "MosaicEventScheduler mobility interest of node " << nodeId
+           << ": " << interested << std::endl;
+  m_mobilityInterest[nodeId] = interested;
+  m_changedInterest.push_back(nodeId);
+}
+
+void MosaicEventScheduler::resetMobilityInterest(int nodeId) {
+  if (!hasMobilityInterest(nodeId)) {
+    m_mobilityInterest[nodeId] = true;
+  }
+}
+
+bool MosaicEventScheduler::hasMobilityInterest(int nodeId) const {
+  return nodeId < 0 ||
+         static_cast<size_t>(nodeId) >= m_mobilityInterest.size() ||
+         m_mobilityInterest[nodeId];
+}
+
 void MosaicEventScheduler::reportReceivedV2xMessage(cMessage *msg) {
+  const SpanTrace::Scope span("report write", "report");
   MosaicAppPacket *packet = check_and_cast<MosaicAppPacket *>(msg);
   EV_DEBUG << "MosaicEventScheduler report RECV_MESSAGE: t="
            << packet->getArrivalTime().str()
            << ", RecNodeId=" << packet->getNodeId()
            << ", MsgId=" << packet->getMsgId() << std::endl;
-
-  m_federateAmbassadorChannel->writeCommand(CMD_MSG_RECV);
-  m_federateAmbassadorChannel->writeReceiveMessage(
+  // batched until the next NEXT_EVENT or END with CAP_RECEIVE_BATCH
+  m_reportWriter->reportReception(
       packet->getArrivalTime().inUnit(SimTimeUnit::SIMTIME_NS),
       packet->getNodeId(), packet->getMsgId(),
-      (RADIO_CHANNEL)packet->getChannelId(), 0);
-  // rssi and channel number are not reported
+      (RADIO_CHANNEL)packet->getChannelId());
 }
 
 void MosaicEventScheduler::processShutDown() {
@@ -281,9 +1104,21 @@ void MosaicEventScheduler::processShutDown() {
 }
 
 void MosaicEventScheduler::processUpdateNode() {
-  CSC_update_node_return update_node_message;
-  m_ambassadorFederateChannel->readUpdateNode(update_node_message);
+  int status;
+  {
+    const SpanTrace::Scope span("decode", "channel");
+    status = m_ambassadorFederateChannel->readUpdateNode(m_updateNodeMessage);
+  }
+  if (status != 0) {
+    reportCommandError(CMD_UPDATE_NODE, "UPDATE_NODE could not be read");
+  } else {
+    applyUpdateNode(m_updateNodeMessage);
+  }
+  acknowledgeCommand();
+}
 
+void MosaicEventScheduler::applyUpdateNode(
+    CSC_update_node_return &update_node_message) {
   simtime_t time(update_node_message.time, SimTimeUnit::SIMTIME_NS);
   const unsigned int numNodes = update_node_message.properties.size();
 
@@ -304,6 +1139,12 @@ void MosaicEventScheduler::processUpdateNode() {
     cmdMessage = processUpdateNodeCommand(numNodes, update_node_message,
                                           MOBILITY_CMD_REMOVE_NODES, false);
   }
+  if (cmdMessage->getNodeIdArraySize() == 0 && numNodes > 0) {
+    // all nodes stayed within mosaiceventscheduler-move-epsilon or are not
+    // interested in their position
+    delete cmdMessage;
+    return;
+  }
 
   cmdMessage->setTimestamp(time);
   cmdMessage->setArrivalTime(time);
@@ -312,7 +1153,6 @@ void MosaicEventScheduler::processUpdateNode() {
   putBackEvent(cmdMessage);
 
   EV_DEBUG << "MosaicEventScheduler finished processing of command" << endl;
-  m_ambassadorFederateChannel->writeCommand(CMD_SUCCESS);
 }
 
 MosaicMobilityCmd *MosaicEventScheduler::processUpdateNodeCommand(
@@ -323,12 +1163,27 @@ MosaicMobilityCmd *MosaicEventScheduler::processUpdateNodeCommand(
   cmdMessage->setNodeIdArraySize(numNodes);
   cmdMessage->setPositionArraySize(newPosition ? numNodes : 0);
 
+  const bool trackPositions = m_moveEpsilon > 0;
+  const bool filterMoves =
+      m_interestFilter && cmd_type == MOBILITY_CMD_MOVE_NODES;
+  unsigned int numApplied = 0;
   for (std::vector<CSC_node_data>::iterator it =
            update_node_message.properties.begin();
        it != update_node_message.properties.end(); ++it) {
     EV_DEBUG << "MosaicEventScheduler " << cmd_type << ": " << it->id
              << " at position " << it->x << "," << it->y << std::endl;
-    const int i = it - update_node_message.properties.begin();
+    if (filterMoves && !hasMobilityInterest(it->id)) {
+      continue;
+    }
+    if (cmd_type == MOBILITY_CMD_ADD_NODES ||
+        cmd_type == MOBILITY_CMD_ADD_RSU_NODES) {
+      // added nodes are interested, like on the side of mosaic
+      resetMobilityInterest(it->id);
+    }
+    if (trackPositions && !updateAppliedPosition(cmd_type, *it)) {
+      continue;
+    }
+    const int i = numApplied++;
     cmdMessage->setNodeId(i, it->id);
     if (newPosition) {
       inet::Coord coord;
@@ -338,12 +1193,60 @@ MosaicMobilityCmd *MosaicEventScheduler::processUpdateNodeCommand(
       cmdMessage->setPosition(i, coord);
     }
   }
+  if (numApplied < numNodes) {
+    m_numSkippedMoves += numNodes - numApplied;
+    cmdMessage->setNodeIdArraySize(numApplied);
+    cmdMessage->setPositionArraySize(newPosition ? numApplied : 0);
+  }
   return cmdMessage;
 }
 
+/**
+ * Keeps the last applied position of each node.
+ *
+ * @return false if a move of the node is closer than
+ *         mosaiceventscheduler-move-epsilon to its last applied position and
+ *         can be skipped
+ */
+bool MosaicEventScheduler::updateAppliedPosition(MobilityCommandType cmd_type,
+                                                 const CSC_node_data &node) {
+  if (node.id < 0) {
+    return true;
+  }
+  // node ids are dense, they are also used as submodule vector indices
+  if (static_cast<size_t>(node.id) >= m_appliedPositions.size()) {
+    m_appliedPositions.resize(node.id + 1, inet::Coord::NIL);
+  }
+  inet::Coord &applied = m_appliedPositions[node.id];
+  if (cmd_type == MOBILITY_CMD_REMOVE_NODES) {
+    applied = inet::Coord::NIL;
+    return true;
+  }
+  const inet::Coord position(node.x, node.y, 0);
+  if (cmd_type == MOBILITY_CMD_MOVE_NODES && !applied.isNil() &&
+      applied.sqrdist(position) < m_moveEpsilon * m_moveEpsilon) {
+    return false;
+  }
+  applied = position;
+  return true;
+}
+
 void MosaicEventScheduler::processMsgSend() {
   CSC_send_message send_message;
-  m_ambassadorFederateChannel->readSendMessage(send_message);
+  int status;
+  {
+    const SpanTrace::Scope span("decode", "channel");
+    status = m_ambassadorFederateChannel->readSendMessage(send_message);
+  }
+  if (status != 0) {
+    reportCommandError(CMD_MSG_SEND, "MSG_SEND could not be read");
+  } else {
+    applyMsgSend(send_message);
+  }
+  acknowledgeCommand();
+}
+
+void MosaicEventScheduler::applyMsgSend(const CSC_send_message &send_message) {
   simtime_t time(send_message.time, SimTimeUnit::SIMTIME_NS);
 
   EV_DEBUG << "MosaicEventScheduler.processMsgSend() received time: "
@@ -371,14 +1274,28 @@ void MosaicEventScheduler::processMsgSend() {
 
   putBackEvent(comMessage);
 
-  m_ambassadorFederateChannel->writeCommand(CMD_SUCCESS);
   EV_DEBUG << "MosaicEventScheduler finished processing of command"
            << std::endl;
 }
 
 void MosaicEventScheduler::processConfRadio() {
   CSC_config_message config_message;
-  m_ambassadorFederateChannel->readConfigurationMessage(config_message);
+  int status;
+  {
+    const SpanTrace::Scope span("decode", "channel");
+    status =
+        m_ambassadorFederateChannel->readConfigurationMessage(config_message);
+  }
+  if (status != 0) {
+    reportCommandError(CMD_CONF_RADIO, "CONF_RADIO could not be read");
+  } else {
+    applyConfRadio(config_message);
+  }
+  acknowledgeCommand();
+}
+
+void MosaicEventScheduler::applyConfRadio(
+    const CSC_config_message &config_message) {
   simtime_t time(config_message.time, SimTimeUnit::SIMTIME_NS);
 
   EV_DEBUG << "MosaicEventScheduler received time: " << time.str() << endl;
@@ -439,21 +1356,131 @@ void MosaicEventScheduler::processConfRadio() {
 
   EV_DEBUG << "MosaicEventScheduler finished processing of command"
            << std::endl;
-  m_ambassadorFederateChannel->writeCommand(CMD_SUCCESS);
+}
+
+/**
+ * Processes all commands of a CMD_COMMAND_BATCH in their order, as if they
+ * were sent one by one, and acknowledges the batch with a single CMD_SUCCESS.
+ * A batch that cannot be read, or with a command that failed, is answered
+ * with CMD_ERROR instead.
+ */
+void MosaicEventScheduler::processCommandBatch() {
+  int status;
+  {
+    const SpanTrace::Scope span("decode", "channel");
+    status = m_ambassadorFederateChannel->readCommandBatch();
+  }
+  if (status != 0) {
+    reportCommandError(CMD_COMMAND_BATCH, "COMMAND_BATCH could not be read");
+    acknowledgeCommand();
+    return;
+  }
+  m_inCommandBatch = true;
+  int numCommands = 0;
+  CMD command;
+  while ((command = m_ambassadorFederateChannel->readBatchCommand()) !=
+         CMD_UNDEF) {
+    switch (command) {
+    case CMD_UPDATE_NODE:
+    case CMD_UPDATE_NODE_PACKED:
+      processUpdateNode();
+      break;
+    case CMD_MSG_SEND:
+      processMsgSend();
+      break;
+    case CMD_CONF_RADIO:
+      processConfRadio();
+      break;
+    default:
+      break;
+    }
+    numCommands++;
+  }
+  m_inCommandBatch = false;
+  EV_DEBUG << "MosaicEventScheduler processed batch of " << numCommands
+           << " commands" << std::endl;
+  acknowledgeCommand();
+}
+
+/**
+ * Acknowledges a command, or a batch, in lock-step mode. If it failed, the
+ * error is sent in place of CMD_SUCCESS.
+ */
+void MosaicEventScheduler::acknowledgeCommand() {
+  if (m_inCommandBatch || (m_capabilities & CAP_PIPELINED)) {
+    return;
+  }
+  if (m_failedCommand != CMD_UNDEF) {
+    m_ambassadorFederateChannel->writeCommandError(
+        m_failedCommand, m_currentMaxSimTime.inUnit(SimTimeUnit::SIMTIME_NS),
+        m_failureDescription);
+    m_failedCommand = CMD_UNDEF;
+  } else {
+    m_ambassadorFederateChannel->writeCommand(CMD_SUCCESS);
+  }
+}
+
+/**
+ * Reports a command that could not be executed. In pipelined mode the report
+ * is sent with the next NEXT_EVENT or END, otherwise it replaces the
+ * acknowledgement of the command.
+ */
+void MosaicEventScheduler::reportCommandError(CMD command,
+                                              const std::string &description) {
+  EV_WARN << "MosaicEventScheduler " << description << std::endl;
+  FlightRecorder::record(FLIGHT_COMMAND_ERROR, command, 0,
+                         m_currentMaxSimTime.inUnit(SimTimeUnit::SIMTIME_NS));
+  if (m_capabilities & CAP_PIPELINED) {
+    m_reportWriter->reportCommandError(
+        command, m_currentMaxSimTime.inUnit(SimTimeUnit::SIMTIME_NS),
+        description);
+  } else if (m_failedCommand == CMD_UNDEF) {
+    // answered by acknowledgeCommand
+    m_failedCommand = command;
+    m_failureDescription = description;
+  }
 }
 
 void MosaicEventScheduler::processAdvanceTime() {
-  const int64_t newMaxTime = m_ambassadorFederateChannel->readTimeMessage();
+  applyAdvanceTime(m_ambassadorFederateChannel->readTimeMessage());
+}
+
+void MosaicEventScheduler::applyAdvanceTime(int64_t newMaxTime) {
+  if (m_syncStatistics) {
+    const int64_t window =
+        newMaxTime - m_currentMaxSimTime.inUnit(SimTimeUnit::SIMTIME_NS);
+    m_grantWindows.record(std::max<int64_t>(window, 0));
+    if (m_syncReportInterval > 0 && m_currentMaxSimTime >= m_nextSyncReport) {
+      // the interval ends with the window granted last
+      reportSyncInterval();
+      m_nextSyncReport += m_syncReportInterval;
+      if (m_nextSyncReport <= m_currentMaxSimTime) {
+        // no grant for several intervals
+        m_nextSyncReport = m_currentMaxSimTime + m_syncReportInterval;
+      }
+    }
+    m_syncInterval.grants++;
+  }
   m_currentMaxSimTime = SimTime(newMaxTime, SimTimeUnit::SIMTIME_NS);
   m_timeAdvancing = true;
+  FlightRecorder::record(FLIGHT_ADVANCE_TIME, CMD_ADVANCE_TIME, 0, newMaxTime);
   EV_DEBUG << "MosaicEventScheduler ADVANCE_TIME: " << m_currentMaxSimTime
            << std::endl;
 }
 
 void MosaicEventScheduler::receiveInteractions() {
+  if (m_commandReceiver != nullptr) {
+    receiveDecodedInteractions();
+    return;
+  }
   CMD command;
   EV_DEBUG << "MosaicEventScheduler wait new command" << std::endl;
-  command = m_ambassadorFederateChannel->readCommand();
+  {
+    const SpanTrace::Scope span("blocked on ambassador", "sync");
+    const uint64_t start = m_syncStatistics ? ChannelStatistics::now() : 0;
+    command = m_ambassadorFederateChannel->readCommand();
+    waitedForAmbassador(start);
+  }
   EV_DEBUG << "MosaicEventScheduler received command: " << command << std::endl;
 
   switch (command) {
@@ -461,6 +1488,7 @@ void MosaicEventScheduler::receiveInteractions() {
     processShutDown();
     break;
   case CMD_UPDATE_NODE:
+  case CMD_UPDATE_NODE_PACKED:
     processUpdateNode();
     break;
   case CMD_MSG_SEND:
@@ -469,19 +1497,93 @@ void MosaicEventScheduler::receiveInteractions() {
   case CMD_CONF_RADIO:
     processConfRadio();
     break;
+  case CMD_COMMAND_BATCH:
+    processCommandBatch();
+    break;
   case CMD_ADVANCE_TIME:
     processAdvanceTime();
     break;
-  default: {
-    m_ambassadorFederateChannel->writeCommand(CMD_END);
-    EV_DEBUG << "MosaicEventScheduler Received unknown command from "
-                "ambassador, ending"
-             << std::endl;
-    m_timeAdvancing = true;
-    cRuntimeError("MosaicEventScheduler FAILURE (received unknown command %d)",
-                  command);
+  default:
+    processUnknownCommand(command);
+  }
+}
+
+/**
+ * Executes the next command decoded by the receiver thread, the counterpart of
+ * receiveInteractions. Commands are not acknowledged in pipelined mode.
+ */
+void MosaicEventScheduler::receiveDecodedInteractions() {
+  EV_DEBUG << "MosaicEventScheduler wait new decoded command" << std::endl;
+  ReceivedCommand *next;
+  {
+    const SpanTrace::Scope span("blocked on ambassador", "sync");
+    const uint64_t start = m_syncStatistics ? ChannelStatistics::now() : 0;
+    next = &m_commandReceiver->front();
+    waitedForAmbassador(start);
+  }
+  ReceivedCommand &received = *next;
+  const CMD command = received.command;
+  EV_DEBUG << "MosaicEventScheduler received command: " << command << std::endl;
+
+  switch (command) {
+  case CMD_SHUT_DOWN:
+    processShutDown();
+    break;
+  case CMD_UPDATE_NODE:
+  case CMD_UPDATE_NODE_PACKED:
+    if (received.status != 0) {
+      reportCommandError(CMD_UPDATE_NODE, "UPDATE_NODE could not be read");
+    } else {
+      applyUpdateNode(received.update_node);
+    }
+    break;
+  case CMD_MSG_SEND:
+    if (received.status != 0) {
+      reportCommandError(CMD_MSG_SEND, "MSG_SEND could not be read");
+    } else {
+      applyMsgSend(received.send_message);
+    }
+    break;
+  case CMD_CONF_RADIO:
+    if (received.status != 0) {
+      reportCommandError(CMD_CONF_RADIO, "CONF_RADIO could not be read");
+    } else {
+      applyConfRadio(received.config_message);
+    }
+    break;
+  case CMD_COMMAND_BATCH:
+    reportCommandError(CMD_COMMAND_BATCH, "COMMAND_BATCH could not be read");
+    break;
+  case CMD_ADVANCE_TIME:
+    applyAdvanceTime(received.time);
+    break;
+  default:
+    // the receiver thread has ended, the channel is written here again
+    m_commandReceiver->pop();
+    delete m_commandReceiver;
+    m_commandReceiver = nullptr;
+    processUnknownCommand(command);
+    return;
   }
+  m_commandReceiver->pop();
+}
+
+void MosaicEventScheduler::processUnknownCommand(CMD command) {
+  m_ambassadorFederateChannel->writeCommand(CMD_END);
+  m_ambassadorFederateChannel->flush();
+  EV_DEBUG << "MosaicEventScheduler Received unknown command from "
+              "ambassador, ending"
+           << std::endl;
+  m_timeAdvancing = true;
+  FlightRecorder::record(FLIGHT_FAILURE, command, 0, 0);
+  dumpFlightRecorder();
+  if (command == CMD_UNDEF && m_transport == "replay") {
+    throw cRuntimeError("MosaicEventScheduler FAILURE (%s ended before "
+                        "SHUT_DOWN, the trace is truncated)",
+                        m_replayFile.c_str());
   }
+  throw cRuntimeError(
+      "MosaicEventScheduler FAILURE (received unknown command %d)", command);
 }
 
 } // namespace omnetpp_federate
@@ -23,15 +23,22 @@
 #ifndef MOSAICEVENTSCHEDULER_H_
 #define MOSAICEVENTSCHEDULER_H_
 
+#include <chrono>
 #include <omnetpp.h>
 
+#include "util/ChannelStatistics.h"
 #include "util/ClientServerChannel.h"
 #include "msg/MosaicMobilityCmd_m.h"
 
+#include "inet/common/geometry/common/Coord.h"
+
 namespace omnetpp_federate {
 using namespace omnetpp;
 using namespace ClientServerChannelSpace;
 
+class CommandReceiver;
+class ReportWriter;
+
 /**
  * Scheduler module for timeadvance nextevent mechanism
  * used in synchronization of mosaic and omnet++.
@@ -39,6 +46,8 @@ using namespace ClientServerChannelSpace;
  * @author rpr
  */
 class MosaicEventScheduler : public cScheduler {
+  /** Calls the command processing directly, see benchmark/ */
+  friend class SchedulerBenchmark;
 
 public:
   MosaicEventScheduler() = default;
@@ -48,6 +57,8 @@ public:
   virtual void endRun();
   virtual void setMgmtModule(cModule *mod);
   virtual void reportReceivedV2xMessage(cMessage *msg);
+  /** Tells the ambassador whether position updates of the node are needed */
+  virtual void setMobilityInterest(int nodeId, bool interested);
 
   virtual cEvent *guessNextEvent();
   virtual cEvent *takeNextEvent();
@@ -57,26 +68,145 @@ private:
   std::string m_host;
   int m_port;
   int m_cmdport;
+  std::string m_transport;
+  std::string m_socketPath;
+  std::string m_shmName;
+  /** trace replayed with the replay transport and its speed, 0 for maximum */
+  std::string m_replayFile;
+  double m_replaySpeed = 0;
+  /** wall-clock time when the replay started to process commands */
+  std::chrono::steady_clock::time_point m_replayStart;
+  /** trace file of the received commands, empty for none */
+  std::string m_recordFile;
+  /** Chrome trace of the spans written at endRun, empty if not tracing */
+  std::string m_traceFile;
+  /** the flight recorder was written on a failure, endRun keeps that file */
+  bool m_flightRecorderDumped = false;
+  /** start of the event being executed in ns, 0 if none or not measured */
+  uint64_t m_eventStart = 0;
+  const char *m_eventSpanName = nullptr;
+  /** synchronization overhead of a run or of a reporting interval */
+  struct SyncCounters {
+    uint64_t waitNs = 0;
+    uint64_t eventNs = 0;
+    long grants = 0;
+    long nextEvents = 0;
+    long events = 0;
+    long emptyGrants = 0;
+  };
+  bool m_syncStatistics = true;
+  /** counters since the last interval, added to the run at its end */
+  SyncCounters m_syncInterval;
+  SyncCounters m_syncRun;
+  /** reporting interval in simulation time, 0 only records the run */
+  simtime_t m_syncReportInterval;
+  simtime_t m_nextSyncReport;
+  uint64_t m_syncStart = 0;
+  long m_eventsInGrant = 0;
+  /** granted windows in ns and events executed per grant */
+  LatencyHistogram m_grantWindows;
+  LatencyHistogram m_eventsPerGrant;
   ClientServerChannel *m_ambassadorFederateChannel;
   ClientServerChannel *m_federateAmbassadorChannel;
   simtime_t m_startTime;
   simtime_t m_stopTime;
   simtime_t m_currentMaxSimTime;
   bool m_timeAdvancing = false;
+  /** protocol extensions offered to the ambassador, see CAPABILITY */
+  uint32_t m_offeredCapabilities = 0;
+  /** protocol extensions selected by the ambassador at CMD_INIT */
+  uint32_t m_capabilities = 0;
+  /** commands of a batch are acknowledged once after the whole batch */
+  bool m_inCommandBatch = false;
+  /** first failed command since the last acknowledgement, answered with
+   * CMD_ERROR instead of CMD_SUCCESS if commands are acknowledged */
+  CMD m_failedCommand = CMD_UNDEF;
+  std::string m_failureDescription;
+  /** decode target reused for all UPDATE_NODE commands */
+  CSC_update_node_return m_updateNodeMessage;
+  /** commands decoded ahead by the receiver thread fill at most this many
+   * slots, each keeps the memory of the largest update it held */
+  static constexpr size_t RECEIVE_QUEUE_SIZE = 64;
+  /** read commands on a second thread if they are pipelined */
+  bool m_receiverThread = false;
+  CommandReceiver *m_commandReceiver = nullptr;
+  /** reports queued for the writer thread, the simulation thread only blocks
+   * if the Ambassador falls this far behind */
+  static constexpr size_t REPORT_QUEUE_SIZE = 4096;
+  /** write reports on a second thread */
+  bool m_writerThread = false;
+  /** the only writer of m_federateAmbassadorChannel after CMD_INIT */
+  ReportWriter *m_reportWriter = nullptr;
+  /** non-blocking polling of the channels before a read blocks */
+  std::chrono::nanoseconds m_busyPoll{0};
+  bool m_tcpNoDelay = true;
+  /** socket buffer sizes in bytes, 0 for the system defaults */
+  int m_socketReceiveBuffer = 0;
+  int m_socketSendBuffer = 0;
+  /** per command statistics of both channels, optionally also as JSON */
+  bool m_channelStatistics = true;
+  std::string m_channelStatisticsJson;
+  /** smallest message in bytes compressed with CAP_COMPRESSION */
+  size_t m_compressionThreshold = 1024;
+  /** moves closer than this distance in meters to the applied position are
+   * skipped */
+  double m_moveEpsilon = 0;
+  /** last applied position per node id, NIL if unknown */
+  std::vector<inet::Coord> m_appliedPositions;
+  long m_numSkippedMoves = 0;
+  /** drop MOVE updates of uninterested nodes even if mosaic still sends them */
+  bool m_interestFilter = false;
+  /** mobility interest per node id, true unless unsubscribed */
+  std::vector<bool> m_mobilityInterest;
+  /** node ids whose interest changed since the last report */
+  std::vector<int> m_changedInterest;
+  std::vector<int> m_subscribe;
+  std::vector<int> m_unsubscribe;
 
   virtual void connectToAmbassador();
+  int prepareChannel(ClientServerChannel *channel, int port);
+  void pinSimulationThread(int cpu);
+  void logCompression(const ClientServerChannel *channel, bool sent);
+  void recordChannelStatistics(const ClientServerChannel *channel,
+                               const std::string &name);
+  void recordLatencyHistogram(const std::string &name,
+                              const LatencyHistogram &histogram,
+                              double scale = 1e-9, const char *unit = "s");
+  void writeChannelStatisticsJson();
+  void startFlightRecorder();
+  void dumpFlightRecorder();
+  void writeSpanTrace();
+  void beginEvent(cEvent *event);
+  void endEvent();
+  void waitedForAmbassador(uint64_t start);
+  void reportSyncInterval();
+  void recordSyncStatistics();
   virtual void reportNextEventToAmbassador(simtime_t nextSimTime);
+  void reportCollected();
   virtual void endTimeAdvance(simtime_t time);
   void receiveInteractions();
+  void receiveDecodedInteractions();
+  void processUnknownCommand(CMD command);
 
   void processShutDown();
   void processUpdateNode();
+  void applyUpdateNode(CSC_update_node_return &update_node_message);
   MosaicMobilityCmd *processUpdateNodeCommand(
       const unsigned int numNodes, CSC_update_node_return &update_node_message,
       MobilityCommandType cmd_type, const bool newPosition = true);
+  bool updateAppliedPosition(MobilityCommandType cmd_type,
+                             const CSC_node_data &node);
+  void resetMobilityInterest(int nodeId);
+  bool hasMobilityInterest(int nodeId) const;
   void processMsgSend();
+  void applyMsgSend(const CSC_send_message &send_message);
   void processConfRadio();
+  void applyConfRadio(const CSC_config_message &config_message);
+  void processCommandBatch();
   void processAdvanceTime();
+  void applyAdvanceTime(int64_t newMaxTime);
+  void acknowledgeCommand();
+  void reportCommandError(CMD command, const std::string &description);
 };
 
 } // namespace omnetpp_federate
@@ -0,0 +1,158 @@
+/*
+ * Copyright (c) 2020 Fraunhofer FOKUS and others. All rights reserved.
+ *
+ * Contact: mosaic@fokus.fraunhofer.de
+ *
+ * This class is developed for the MOSAIC-OMNeT++ coupling.
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License version 2 as
+ * published by the Free Software Foundation;
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+ *
+ */
+
+#include "ReportWriter.h"
+
+#include "util/SpanTrace.h"
+
+namespace omnetpp_federate {
+
+ReportWriter::ReportWriter(ClientServerChannel *channel, bool receiveBatch)
+    : m_channel(channel), m_receiveBatch(receiveBatch) {}
+
+ReportWriter::~ReportWriter() {
+  stop();
+  delete m_queue;
+}
+
+void ReportWriter::start(size_t capacity) {
+  m_queue = new SpscRing<Report>(capacity);
+  m_thread = std::thread(&ReportWriter::run, this);
+}
+
+void ReportWriter::stop() {
+  if (!m_thread.joinable()) {
+    return;
+  }
+  beginReport(Report::STOP);
+  commitReport();
+  m_thread.join();
+}
+
+void ReportWriter::reportReception(int64_t time, int node_id, int message_id,
+                                   RADIO_CHANNEL channel) {
+  Report &report = beginReport(Report::RECEPTION);
+  report.time = time;
+  report.node_id = node_id;
+  report.message_id = message_id;
+  report.channel = channel;
+  commitReport();
+}
+
+void ReportWriter::reportMobilityInterest(
+    const std::vector<int> &subscribe, const std::vector<int> &unsubscribe) {
+  Report &report = beginReport(Report::MOBILITY_INTEREST);
+  report.subscribe.assign(subscribe.begin(), subscribe.end());
+  report.unsubscribe.assign(unsubscribe.begin(), unsubscribe.end());
+  commitReport();
+}
+
+void ReportWriter::reportCommandError(CMD command, int64_t time,
+                                      const std::string &description) {
+  Report &report = beginReport(Report::COMMAND_ERROR);
+  report.command = command;
+  report.time = time;
+  report.description = description;
+  commitReport();
+}
+
+void ReportWriter::reportNextEvent(int64_t time) {
+  beginReport(Report::NEXT_EVENT).time = time;
+  commitReport();
+}
+
+void ReportWriter::reportEnd(int64_t time) {
+  beginReport(Report::END).time = time;
+  commitReport();
+}
+
+Report &ReportWriter::beginReport(Report::KIND kind) {
+  // the queue is never closed, beginPush only blocks while it is full
+  Report *report = m_thread.joinable() ? m_queue->beginPush() : &m_report;
+  report->kind = kind;
+  return *report;
+}
+
+void ReportWriter::commitReport() {
+  if (m_thread.joinable()) {
+    m_queue->commitPush();
+  } else {
+    write(m_report);
+  }
+}
+
+void ReportWriter::run() {
+  SpanTrace::setThreadName("writer");
+  while (true) {
+    const Report &report = m_queue->front();
+    if (report.kind == Report::STOP) {
+      m_queue->pop();
+      break;
+    }
+    write(report);
+    m_queue->pop();
+  }
+  m_channel->flush();
+}
+
+void ReportWriter::write(const Report &report) {
+  if (report.kind == Report::RECEPTION) {
+    if (m_receiveBatch) {
+      m_channel->addReceiveMessage(report.time, report.node_id,
+                                   report.message_id, report.channel, 0);
+    } else {
+      // rssi and channel number are not reported
+      m_channel->writeCommand(CMD_MSG_RECV);
+      m_channel->writeReceiveMessage(report.time, report.node_id,
+                                     report.message_id, report.channel, 0);
+    }
+    return;
+  }
+  // the receptions of the time advance precede all other reports
+  m_channel->writeReceiveMessageBatch();
+  switch (report.kind) {
+  case Report::MOBILITY_INTEREST:
+    m_channel->writeMobilityInterest(report.subscribe, report.unsubscribe);
+    break;
+  case Report::COMMAND_ERROR:
+    m_channel->writeCommandError(report.command, report.time,
+                                 report.description);
+    break;
+  case Report::NEXT_EVENT:
+    m_channel->writeCommand(CMD_NEXT_EVENT);
+    m_channel->writeTimeMessage(report.time);
+    break;
+  case Report::END:
+    m_channel->writeCommand(CMD_END);
+    m_channel->writeTimeMessage(report.time);
+    {
+      // all reports of this time advance are sent as one batch of frames
+      const SpanTrace::Scope span("flush", "sync");
+      m_channel->flush();
+    }
+    break;
+  default:
+    break;
+  }
+}
+
+} // namespace omnetpp_federate
@@ -0,0 +1,108 @@
+/*
+ * Copyright (c) 2020 Fraunhofer FOKUS and others. All rights reserved.
+ *
+ * Contact: mosaic@fokus.fraunhofer.de
+ *
+ * This class is developed for the MOSAIC-OMNeT++ coupling.
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License version 2 as
+ * published by the Free Software Foundation;
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+ *
+ */
+
+#ifndef REPORTWRITER_H_
+#define REPORTWRITER_H_
+
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "util/ClientServerChannel.h"
+#include "util/SpscRing.h"
+
+namespace omnetpp_federate {
+using namespace ClientServerChannelSpace;
+
+/** A report to the Ambassador, slots of the queue are reused. */
+struct Report {
+  enum KIND {
+    RECEPTION,
+    MOBILITY_INTEREST,
+    COMMAND_ERROR,
+    NEXT_EVENT,
+    END,
+    STOP
+  };
+  KIND kind = STOP;
+  int64_t time = 0;
+  int node_id = 0;
+  int message_id = 0;
+  RADIO_CHANNEL channel = UNDEF_CHANNEL;
+  CMD command = CMD_UNDEF;
+  std::string description;
+  std::vector<int> subscribe;
+  std::vector<int> unsubscribe;
+};
+
+/**
+ * Serializes the reports of the federate and writes them to the Ambassador.
+ * Receptions are sent in one batch if selected, it precedes the next report of
+ * another kind. END flushes the channel.
+ *
+ * Without start() each report is written right away on the calling thread.
+ * After start() the reports are queued and written on an own thread, so that
+ * a slow Ambassador or a full socket buffer does not stall the execution of
+ * events. Only the producer blocks if the queue is full. Once started, no
+ * other thread may write to the channel until stop().
+ */
+class ReportWriter {
+
+public:
+  ReportWriter(ClientServerChannel *channel, bool receiveBatch);
+
+  /** Stops the thread, see stop(). */
+  virtual ~ReportWriter();
+
+  /** Writes the following reports on an own thread. */
+  virtual void start(size_t capacity);
+
+  /** Writes the queued reports and ends the thread. */
+  virtual void stop();
+
+  void reportReception(int64_t time, int node_id, int message_id,
+                       RADIO_CHANNEL channel);
+  void reportMobilityInterest(const std::vector<int> &subscribe,
+                              const std::vector<int> &unsubscribe);
+  void reportCommandError(CMD command, int64_t time,
+                          const std::string &description);
+  void reportNextEvent(int64_t time);
+  void reportEnd(int64_t time);
+
+private:
+  ClientServerChannel *m_channel;
+  bool m_receiveBatch;
+  /** null until start() */
+  SpscRing<Report> *m_queue = nullptr;
+  std::thread m_thread;
+  /** slot of the reports that are written right away */
+  Report m_report;
+
+  Report &beginReport(Report::KIND kind);
+  void commitReport();
+  void run();
+  void write(const Report &report);
+};
+
+} // namespace omnetpp_federate
+
+#endif /* REPORTWRITER_H_ */
@@ -36,6 +36,7 @@
 #include "inet/transportlayer/common/L4PortTag_m.h"
 #include "inet/transportlayer/contract/udp/UdpSocket.h"
 
+#include "mgmt/MosaicEventScheduler.h"
 #include "msg/MosaicAppPacket_m.h"
 
 namespace omnetpp_federate {
@@ -285,6 +286,7 @@ void MosaicProxyApp::handleConfiguration(MosaicConfigurationCmd *cmd) {
  * @param number the number of radios
  */
 void MosaicProxyApp::connectRadios(int number) {
+  const bool wasConnected = numRadios > 0;
   switch (number) {
   case 0:
     if (numRadios > 0) {
@@ -294,7 +296,7 @@ void MosaicProxyApp::connectRadios(int number) {
       }
     }
     numRadios = 0;
-    return;
+    break;
   case 1:
     if (numRadios == 0) {
       radio0->setRadioMode(inet::physicallayer::IRadio::RADIO_MODE_RECEIVER);
@@ -303,7 +305,7 @@ void MosaicProxyApp::connectRadios(int number) {
       radio1->setRadioMode(inet::physicallayer::IRadio::RADIO_MODE_OFF);
     }
     numRadios = 1;
-    return;
+    break;
   case 2:
     if (numRadios < 2) {
       if (numRadios == 0) {
@@ -312,10 +314,17 @@ void MosaicProxyApp::connectRadios(int number) {
       radio1->setRadioMode(inet::physicallayer::IRadio::RADIO_MODE_RECEIVER);
     }
     numRadios = 2;
-    return;
+    break;
   default:
     return;
   }
+  // the position of a node without radios does not affect the simulation
+  if (wasConnected != (numRadios > 0)) {
+    if (auto *scheduler = dynamic_cast<MosaicEventScheduler *>(
+            getSimulation()->getScheduler())) {
+      scheduler->setMobilityInterest(m_externalId, numRadios > 0);
+    }
+  }
 }
 
 void MosaicProxyApp::handleMessageWhenUp(omnetpp::cMessage *msg) {
@@ -0,0 +1,115 @@
+/*
+ * Copyright (c) 2020 Fraunhofer FOKUS and others. All rights reserved.
+ *
+ * Contact: mosaic@fokus.fraunhofer.de
+ *
+ * This class is developed for the MOSAIC-OMNeT++ coupling.
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License version 2 as
+ * published by the Free Software Foundation;
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+ *
+ */
+
+#include "ChannelStatistics.h"
+
+#include <algorithm>
+
+#include "ClientServerChannelMessages.pb.h"
+
+namespace ClientServerChannelSpace {
+
+int LatencyHistogram::bucketIndex(uint64_t value) {
+  if (value < SUB_BUCKETS) {
+    return value;
+  }
+  // the highest bit selects the power of two, the next four the sub bucket
+  const int shift = 63 - __builtin_clzll(value) - 4;
+  return (shift + 1) * SUB_BUCKETS + (value >> shift) - SUB_BUCKETS;
+}
+
+uint64_t LatencyHistogram::bucketLowerBound(int bucket) {
+  if (bucket < SUB_BUCKETS) {
+    return bucket;
+  }
+  const int shift = bucket / SUB_BUCKETS - 1;
+  return uint64_t(SUB_BUCKETS + bucket % SUB_BUCKETS) << shift;
+}
+
+uint64_t LatencyHistogram::getPercentile(double percent) const {
+  if (count == 0) {
+    return 0;
+  }
+  const uint64_t rank =
+      std::max<uint64_t>(1, static_cast<uint64_t>(percent / 100 * count + 0.5));
+  uint64_t seen = 0;
+  for (int bucket = 0; bucket < NUM_BUCKETS; bucket++) {
+    seen += buckets[bucket];
+    if (seen >= rank) {
+      return std::min(std::max(bucketLowerBound(bucket), min), max);
+    }
+  }
+  return max;
+}
+
+void LatencyHistogram::writeJson(std::ostream &out) const {
+  out << "{\"count\": " << count << ", \"min\": " << getMin()
+      << ", \"mean\": " << getMean() << ", \"p50\": " << getPercentile(50)
+      << ", \"p90\": " << getPercentile(90)
+      << ", \"p99\": " << getPercentile(99) << ", \"max\": " << max
+      << ", \"buckets\": [";
+  const char *separator = "";
+  for (int bucket = 0; bucket < NUM_BUCKETS && count > 0; bucket++) {
+    if (buckets[bucket] > 0) {
+      // lower bound and number of values
+      out << separator << "[" << bucketLowerBound(bucket) << ", "
+          << buckets[bucket] << "]";
+      separator = ", ";
+    }
+  }
+  out << "]}";
+}
+
+std::string ChannelStatistics::commandName(int command) {
+  if (!CommandMessage_CommandType_IsValid(command)) {
+    return "CMD_" + std::to_string(command);
+  }
+  return CommandMessage_CommandType_Name(
+      static_cast<CommandMessage_CommandType>(command));
+}
+
+void ChannelStatistics::writeJson(std::ostream &out) const {
+  out << "{\"commands\": {";
+  const char *separator = "";
+  for (int command = -1; command <= MAX_COMMAND; command++) {
+    const CommandStatistics *statistics = find(command);
+    if (statistics == nullptr) {
+      continue;
+    }
+    out << separator << "\n  \"" << commandName(command)
+        << "\": {\"received\": " << statistics->received
+        << ", \"sent\": " << statistics->sent
+        << ", \"bytes_in\": " << statistics->bytes_in
+        << ", \"bytes_out\": " << statistics->bytes_out
+        << ",\n    \"decode_ns\": ";
+    statistics->decode_ns.writeJson(out);
+    out << ",\n    \"wait_ns\": ";
+    statistics->wait_ns.writeJson(out);
+    out << "}";
+    separator = ",";
+  }
+  out << "},\n  \"flushed_bytes\": " << flushed_bytes << ", \"flush_ns\": ";
+  flush_ns.writeJson(out);
+  out << "}";
+}
+
+} // namespace ClientServerChannelSpace
@@ -0,0 +1,183 @@
+/*
+ * Copyright (c) 2020 Fraunhofer FOKUS and others. All rights reserved.
+ *
+ * Contact: mosaic@fokus.fraunhofer.de
+ *
+ * This class is developed for the MOSAIC-OMNeT++ coupling.
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License version 2 as
+ * published by the Free Software Foundation;
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+ *
+ */
+
+#ifndef __CHANNELSTATISTICS_H__
+#define __CHANNELSTATISTICS_H__
+
+#include <array>
+#include <chrono>
+#include <cstdint>
+#include <memory>
+#include <ostream>
+#include <string>
+#include <vector>
+
+namespace ClientServerChannelSpace {
+
+/**
+ * Log-linear histogram of durations in nanoseconds, in the style of
+ * HdrHistogram. Values below 16 have their own bucket, above each power of two
+ * is split into 16 buckets, so a bucket is at most 1/16 of its values wide.
+ * Recording is an index computation and an increment, the buckets are only
+ * allocated by the first value.
+ */
+class LatencyHistogram {
+
+public:
+  static constexpr int SUB_BUCKETS = 16;
+  /** Buckets needed for all 64 bit values. */
+  static constexpr int NUM_BUCKETS = 61 * SUB_BUCKETS;
+
+  void record(uint64_t value) {
+    if (buckets.empty()) {
+      buckets.resize(NUM_BUCKETS);
+    }
+    buckets[bucketIndex(value)]++;
+    count++;
+    sum += value;
+    min = value < min ? value : min;
+    max = value > max ? value : max;
+  }
+
+  uint64_t getCount() const { return count; }
+  uint64_t getSum() const { return sum; }
+  uint64_t getMin() const { return count > 0 ? min : 0; }
+  uint64_t getMax() const { return max; }
+  double getMean() const { return count > 0 ? double(sum) / count : 0; }
+
+  /** Lower bound of the bucket holding the given percentile (0-100). */
+  uint64_t getPercentile(double percent) const;
+
+  /** Number of values in a bucket, 0 before the first value. */
+  uint64_t getBucketCount(int bucket) const {
+    return buckets.empty() ? 0 : buckets[bucket];
+  }
+
+  static int bucketIndex(uint64_t value);
+
+  /** Smallest value of a bucket, the next bucket starts behind its largest. */
+  static uint64_t bucketLowerBound(int bucket);
+
+  /** Writes the counters, percentiles and non-empty buckets as JSON. */
+  void writeJson(std::ostream &out) const;
+
+private:
+  std::vector<uint64_t> buckets;
+  uint64_t count = 0;
+  uint64_t sum = 0;
+  uint64_t min = UINT64_MAX;
+  uint64_t max = 0;
+};
+
+/** Counters of one command type on one channel. */
+struct CommandStatistics {
+  uint64_t received = 0;
+  uint64_t sent = 0;
+  /**
+   * Received are the sizes of the command messages and their bodies after
+   * decompression, sent the frames appended to the output including prefixes.
+   */
+  uint64_t bytes_in = 0;
+  uint64_t bytes_out = 0;
+  /** Time of the read method, including the reception of the body. */
+  LatencyHistogram decode_ns;
+  /** Time blocked in receive calls until the command arrived. */
+  LatencyHistogram wait_ns;
+};
+
+/**
+ * Counters and histograms of a channel per command type. Commands are keyed
+ * by their number, CMD and CommandMessage::CommandType use the same values.
+ * The class has no OMNeT++ dependencies so that stand-in peers can use it.
+ */
+class ChannelStatistics {
+
+public:
+  /** Command numbers from -1 (UNDEF) up to this one are counted apart. */
+  static constexpr int MAX_COMMAND = 62;
+
+  /** Monotonic time in nanoseconds. */
+  static uint64_t now() {
+    return std::chrono::duration_cast<std::chrono::nanoseconds>(
+               std::chrono::steady_clock::now().time_since_epoch())
+        .count();
+  }
+
+  /** Counters of a command, created by the first use. */
+  CommandStatistics &command(int command) {
+    std::unique_ptr<CommandStatistics> &entry = commands[index(command)];
+    if (!entry) {
+      entry.reset(new CommandStatistics());
+    }
+    return *entry;
+  }
+
+  /** Counters of a command, null if it was never used. */
+  const CommandStatistics *find(int command) const {
+    return commands[index(command)].get();
+  }
+
+  /** Records the duration of a flush, blocked in send. */
+  void flushed(uint64_t bytes, uint64_t duration_ns) {
+    flushed_bytes += bytes;
+    flush_ns.record(duration_ns);
+  }
+
+  uint64_t getFlushedBytes() const { return flushed_bytes; }
+  const LatencyHistogram &getFlushHistogram() const { return flush_ns; }
+
+  /** Name of the protocol command type, e.g. ADVANCE_TIME. */
+  static std::string commandName(int command);
+
+  /** Writes all counters as a JSON object. */
+  void writeJson(std::ostream &out) const;
+
+  /** Records its lifetime as decode time of a command, if enabled. */
+  class DecodeTimer {
+  public:
+    DecodeTimer(ChannelStatistics *statistics, int command)
+        : statistics(statistics), command(command),
+          start(statistics != nullptr ? now() : 0) {}
+    ~DecodeTimer() {
+      if (statistics != nullptr) {
+        statistics->command(command).decode_ns.record(now() - start);
+      }
+    }
+
+  private:
+    ChannelStatistics *statistics;
+    int command;
+    uint64_t start;
+  };
+
+private:
+  std::array<std::unique_ptr<CommandStatistics>, MAX_COMMAND + 2> commands;
+  uint64_t flushed_bytes = 0;
+  LatencyHistogram flush_ns;
+
+  static int index(int command) {
+    return command >= -1 && command <= MAX_COMMAND ? command + 1 : 0;
+  }
+};
+
+} // namespace ClientServerChannelSpace
+#endif
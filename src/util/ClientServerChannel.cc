@@ -24,21 +24,35 @@
 
 #include <arpa/inet.h>
 #include <errno.h>
+#include <fcntl.h>
 #include <google/protobuf/io/coded_stream.h>
 #include <google/protobuf/io/zero_copy_stream_impl.h>
 #include <google/protobuf/message.h>
+#include <google/protobuf/wire_format_lite.h>
+#include <algorithm>
+#include <chrono>
+#include <climits>
+#include <cstring>
 #include <iomanip>
 #include <iostream>
 #include <netdb.h>
 #include <netinet/tcp.h>
-#include <poll.h>
 #include <sstream>
 #include <stdio.h>
+#include <sys/file.h>
 #include <sys/socket.h>
+#include <sys/stat.h>
+#include <sys/un.h>
 #include <unistd.h>
 #include <vector>
 
+#include "ChannelStatistics.h"
+#include "FlatMessages.h"
+#include "FlightRecorder.h"
+#include "FrameCompression.h"
+#include "FrameTrace.h"
 #include "Log.h"
+#include "ShmChannel.h"
 #include <omnetpp.h>
 
 LOG_COMPONENT_DEFINE("ClientServerChannel");
@@ -65,6 +79,12 @@ ostream &operator<<(ostream &out, ClientServerChannelSpace::CMD cmd) {
   case ClientServerChannelSpace::CMD::CMD_REMOVE_NODE:
     out << "CMD remove node";
     break;
+  case ClientServerChannelSpace::CMD::CMD_UPDATE_NODE_PACKED:
+    out << "CMD update node packed";
+    break;
+  case ClientServerChannelSpace::CMD::CMD_MOBILITY_INTEREST:
+    out << "CMD mobility interest";
+    break;
   case ClientServerChannelSpace::CMD::CMD_ADVANCE_TIME:
     out << "CMD advance time";
     break;
@@ -74,6 +94,9 @@ ostream &operator<<(ostream &out, ClientServerChannelSpace::CMD cmd) {
   case ClientServerChannelSpace::CMD::CMD_MSG_RECV:
     out << "CMD message receive";
     break;
+  case ClientServerChannelSpace::CMD::CMD_MSG_RECV_BATCH:
+    out << "CMD message receive batch";
+    break;
   case ClientServerChannelSpace::CMD::CMD_MSG_SEND:
     out << "CMD message send";
     break;
@@ -86,6 +109,12 @@ ostream &operator<<(ostream &out, ClientServerChannelSpace::CMD cmd) {
   case ClientServerChannelSpace::CMD::CMD_SUCCESS:
     out << "CMD success";
     break;
+  case ClientServerChannelSpace::CMD::CMD_ERROR:
+    out << "CMD error";
+    break;
+  case ClientServerChannelSpace::CMD::CMD_COMMAND_BATCH:
+    out << "CMD command batch";
+    break;
   }
   return out;
 }
@@ -183,7 +212,8 @@ std::string uint32_to_ip(const unsigned int ip) {
 /**
  * Constructor.
  */
-ClientServerChannel::ClientServerChannel() {
+ClientServerChannel::ClientServerChannel()
+    : recv_buffer(RECV_BUFFER_SIZE), recv_begin(0), recv_end(0) {
   servsock = INVALID_SOCKET;
   sock = INVALID_SOCKET;
   omnetpp::LogLevel level = omnetpp::cLog::resolveLogLevel(
@@ -243,6 +273,7 @@ int ClientServerChannel::prepareConnection(std::string host, uint32_t port) {
         << strerror(errno) << std::endl;
   }
 
+  applySocketBuffers();
   listen(servsock, 3);
   int len = sizeof(servaddr);
   getsockname(servsock, (struct sockaddr *)&servaddr, (socklen_t *)&len);
@@ -250,14 +281,171 @@ int ClientServerChannel::prepareConnection(std::string host, uint32_t port) {
   return ntohs(servaddr.sin_port);
 }
 
+/**
+ * Locks the file "<socket_path>.lock" that marks the owner of a Unix domain
+ * socket path. The lock ends with the process, so a socket file whose lock
+ * can be taken is left over by a process that ended.
+ *
+ * @return descriptor holding the lock, -1 with errno EWOULDBLOCK if another
+ *         process holds it
+ */
+static int lockSocketPath(const std::string &socket_path) {
+  const std::string lock_path = socket_path + ".lock";
+  for (;;) {
+    const int fd = open(lock_path.c_str(), O_CREAT | O_RDWR | O_CLOEXEC, 0600);
+    if (fd < 0) {
+      return -1;
+    }
+    if (flock(fd, LOCK_EX | LOCK_NB) < 0) {
+      const int error = errno;
+      close(fd);
+      errno = error;
+      return -1;
+    }
+    // the previous owner may have removed the file before the lock was taken
+    struct stat locked;
+    struct stat current;
+    if (fstat(fd, &locked) == 0 && stat(lock_path.c_str(), &current) == 0 &&
+        locked.st_ino == current.st_ino && locked.st_dev == current.st_dev) {
+      return fd;
+    }
+    close(fd);
+  }
+}
+
+/**
+ * Provides a Unix domain server socket for incoming messages from the
+ * Ambassador. The socket is created at the path "<path>-<port>", so the port
+ * number keeps identifying the channel towards the Ambassador and the port
+ * exchange of the connection protocol stays unchanged. If port is 0, the first
+ * unused number starting at a process specific offset is chosen. The path is
+ * owned by the process holding the lock of "<path>-<port>.lock", the socket
+ * of another federate is never replaced.
+ *
+ * @param path path prefix of the socket file
+ * @param port number used as suffix of the socket file, 0 to choose one
+ * @return assigned port number
+ */
+int ClientServerChannel::prepareUnixConnection(std::string path,
+                                               uint32_t port) {
+  servsock = socket(AF_UNIX, SOCK_STREAM, 0);
+  if (servsock < 0) {
+    std::cerr << "Error: ClientServerChannel could not create socket to "
+                 "connect to Ambassador - "
+              << strerror(errno) << std::endl;
+    return 0;
+  }
+
+  const bool choosePort = (port == 0);
+  if (choosePort) {
+    port = 10000 + getpid() % 50000;
+  }
+  for (int attempts = 0; attempts < 100; attempts++, port++) {
+    sockaddr_un servaddr;
+    memset((char *)&servaddr, 0, sizeof(servaddr));
+    servaddr.sun_family = AF_UNIX;
+    const std::string socketPath = path + "-" + std::to_string(port);
+    if (socketPath.size() >= sizeof(servaddr.sun_path)) {
+      std::cerr << "Error: ClientServerChannel socket path too long: "
+                << socketPath << std::endl;
+      return 0;
+    }
+    strncpy(servaddr.sun_path, socketPath.c_str(), sizeof(servaddr.sun_path));
+    const int lock = lockSocketPath(socketPath);
+    if (lock < 0 && choosePort && errno == EWOULDBLOCK) {
+      continue;
+    }
+    if (lock < 0) {
+      std::cerr << "Error: ClientServerChannel socket path is used by another "
+                   "process: "
+                << socketPath << " - " << strerror(errno) << std::endl;
+      return 0;
+    }
+    // the lock owns the path, a socket file of an ended run is replaced (like
+    // SO_REUSEADDR)
+    unlink(socketPath.c_str());
+    if (bind(servsock, (struct sockaddr *)&servaddr, sizeof(servaddr)) == 0) {
+      unix_path = socketPath;
+      unix_lock = lock;
+      applySocketBuffers();
+      listen(servsock, 3);
+      return port;
+    }
+    close(lock);
+    break;
+  }
+  std::cerr << "Warn: ClientServerChannel could not bind socket to Ambassador - "
+            << strerror(errno) << std::endl;
+  return 0;
+}
+
+/**
+ * Provides a shared memory segment for messages from and to the Ambassador.
+ * The segment is named "<name>-<port>", analogous to Unix domain sockets. If
+ * port is 0, a process specific number is chosen.
+ *
+ * @param name POSIX shared memory name prefix, starting with '/'
+ * @param port number used as suffix of the segment name, 0 to choose one
+ * @return assigned port number
+ */
+int ClientServerChannel::prepareShmConnection(std::string name,
+                                              uint32_t port) {
+  if (port == 0) {
+    static uint32_t nextPort = 10000 + getpid() % 50000;
+    port = nextPort++;
+  }
+  shm = new ShmChannel();
+  if (!shm->create(name + "-" + std::to_string(port))) {
+    std::cerr << "Warn: ClientServerChannel could not create shared memory "
+                 "for Ambassador - "
+              << strerror(errno) << std::endl;
+    delete shm;
+    shm = nullptr;
+    return 0;
+  }
+  return port;
+}
+
+/**
+ * Replays the frames of a recorded trace instead of connecting to the
+ * Ambassador. Frames are taken from the mapped trace as they were read in the
+ * recording, after decompression, and everything written is dropped by flush.
+ *
+ * @param trace_path trace written by enableRecording, empty to only drop the
+ *        output
+ * @param speed factor of the recorded pace, 0 for maximum speed
+ * @return true if the trace could be opened
+ */
+bool ClientServerChannel::prepareReplayConnection(std::string trace_path,
+                                                  double speed) {
+  replaying = true;
+  if (trace_path.empty()) {
+    return true;
+  }
+  replay = new FrameTraceReader();
+  return replay->open(trace_path, speed);
+}
+
 /**
  * Accepts connection to socket (blocking)
  *
  */
 void ClientServerChannel::connect(void) {
-  sockaddr_in address;
-  size_t len = sizeof(address);
-  sock = accept(servsock, (struct sockaddr *)&address, (socklen_t *)&len);
+  if (replaying) {
+    return;
+  }
+  if (shm != nullptr) {
+    // the Ambassador maps the segment instead of connecting to a socket
+    if (!shm->waitForPeer()) {
+      std::cerr << "Error: ClientServerChannel Ambassador did not attach to "
+                   "shared memory"
+                << std::endl;
+    }
+    return;
+  }
+  sockaddr_storage address;
+  socklen_t len = sizeof(address);
+  sock = accept(servsock, (struct sockaddr *)&address, &len);
 
   if (sock < 0) {
     std::cerr << "Error: ClientServerChannel could not accept connection from "
@@ -265,17 +453,44 @@ void ClientServerChannel::connect(void) {
               << strerror(errno) << std::endl;
   }
 
-  int x = 1;
-  setsockopt(sock, IPPROTO_TCP, TCP_NODELAY, (const char *)&x, sizeof(x));
+  if (unix_path.empty() && tcp_no_delay) {
+    applySocketOption(sock, IPPROTO_TCP, TCP_NODELAY, 1, "TCP_NODELAY");
+  }
+}
+
+void ClientServerChannel::applySocketBuffers() {
+  if (socket_receive_buffer > 0) {
+    applySocketOption(servsock, SOL_SOCKET, SO_RCVBUF, socket_receive_buffer,
+                      "SO_RCVBUF");
+  }
+  if (socket_send_buffer > 0) {
+    applySocketOption(servsock, SOL_SOCKET, SO_SNDBUF, socket_send_buffer,
+                      "SO_SNDBUF");
+  }
+}
+
+void ClientServerChannel::setSocketOptions(bool no_delay, int receive_buffer,
+                                           int send_buffer) {
+  tcp_no_delay = no_delay;
+  socket_receive_buffer = receive_buffer;
+  socket_send_buffer = send_buffer;
+}
+
+void ClientServerChannel::setBusyPoll(std::chrono::nanoseconds duration) {
+  busy_poll = duration;
+  if (shm != nullptr) {
+    shm->setBusyPoll(duration);
+  }
 }
 
 /**
- * Closes existing network connections.
+ * Sends pending output and closes existing network connections.
  *
  */
 ClientServerChannel::~ClientServerChannel() {
 
   if (sock >= 0) {
+    flush();
     close(sock);
     sock = -1;
   }
@@ -283,6 +498,21 @@ ClientServerChannel::~ClientServerChannel() {
     close(servsock);
     servsock = -1;
   }
+  if (!unix_path.empty()) {
+    unlink(unix_path.c_str());
+    unlink((unix_path + ".lock").c_str());
+    close(unix_lock);
+  }
+  if (shm != nullptr) {
+    flush();
+    delete shm;
+    shm = nullptr;
+  }
+  delete compression;
+  delete statistics;
+  delete replay;
+  delete recording;
+  log_flush();
 }
 
 // #####################################################
@@ -315,63 +545,41 @@ std::string debug_byte_array(const char *buffer, const size_t buffer_size) {
  */
 CMD ClientServerChannel::readCommand() {
   LOG_FUNCTION(this);
-  // Read the mandatory prefixed size
-  const std::shared_ptr<uint32_t> message_size = readVarintPrefix(sock);
-  if (!message_size || *message_size < 0) {
-    std::cerr << "ERROR: reading of mandatory message size failed!"
-              << std::endl;
-    return CMD_UNDEF;
-  }
-  LOG_LOGIC("read command announced message size: " << *message_size);
-  // Allocate a fitting buffer and read message from stream
-  std::vector<char> message_buffer(*message_size);
-  size_t res = recv(sock, message_buffer.data(), *message_size, MSG_WAITALL);
-  LOG_LOGIC("readCommand recv result: " << res);
-  if (*message_size > 0 && res != *message_size) {
-    std::cerr << "ERROR: expected " << *message_size << " bytes, but red "
-              << res << " bytes. poll ... " << std::endl;
-    struct pollfd socks[1];
-    socks[0].fd = sock;
-    socks[0].events = POLLRDNORM | POLLERR;
-    socks[0].revents = 0;
-    int poll_res = 0;
-    int retries = 3;
-    do {
-      poll_res = poll(socks, 1, 1000);
-      LOG_LOGIC("poll res: " << poll_res);
-      retries--;
-      if (retries == 0) {
-        break;
-      }
-      sleep(1);
-      LOG_LOGIC("poll ...");
-    } while (poll_res < 1);
-    res = recv(sock, message_buffer.data(), *message_size, MSG_WAITALL);
-    if (retries != 3 && res < 1) {
-      std::cerr << "ERROR: socket is ready, but cannot receive any bytes ("
-                << res << "). Message sent?" << std::endl;
-      return CMD_UNDEF;
-    }
-  }
-  if (res != *message_size) {
-    std::cerr << "ERROR: reading of message body failed! Socket not ready."
-              << std::endl;
+  last_command = CMD_UNDEF;
+  receive_blocked_ns = 0;
+  // Read the mandatory prefixed size and the message body
+  const char *message_buffer;
+  uint32_t message_size;
+  if (!readFrame(message_buffer, message_size)) {
+    if (!receive_shutdown) {
+      std::cerr << "ERROR: reading of command message failed!" << std::endl;
+    }
     return CMD_UNDEF;
   }
-  if (*message_size > 0) {
+  LOG_LOGIC("read command announced message size: " << message_size);
+  if (message_size > 0) {
     LOG_LOGIC("message buffer as byte array: "
-              << debug_byte_array(message_buffer.data(), *message_size));
+              << debug_byte_array(message_buffer, message_size));
     // Create the streams that can parse the received data into the protobuf
     // class
-    google::protobuf::io::ArrayInputStream arrayIn(message_buffer.data(),
-                                                   *message_size);
+    google::protobuf::io::ArrayInputStream arrayIn(message_buffer,
+                                                   message_size);
     google::protobuf::io::CodedInputStream codedIn(&arrayIn);
 
-    CommandMessage commandMessage;
+    CommandMessage &commandMessage = received_command;
     commandMessage.ParseFromCodedStream(&codedIn); // parse message
     // pick the needed data from the protobuf message class and return it
     const CMD cmd = protoCMDToCMD(commandMessage.command_type());
     LOG_INFO("read command: " << cmd);
+    if (statistics != nullptr) {
+      CommandStatistics &counters = statistics->command(cmd);
+      counters.received++;
+      counters.bytes_in += message_size;
+      counters.wait_ns.record(receive_blocked_ns);
+    }
+    FlightRecorder::record(FLIGHT_COMMAND_IN, cmd, message_size,
+                           receive_blocked_ns);
+    last_command = cmd;
     return cmd;
   }
   return CMD_UNDEF;
@@ -385,28 +593,28 @@ CMD ClientServerChannel::readCommand() {
  */
 int ClientServerChannel::readInit(CSC_init_return &return_value) {
   LOG_FUNCTION(this);
-  const std::shared_ptr<uint32_t> message_size = readVarintPrefix(sock);
-  if (!message_size) {
+  const ChannelStatistics::DecodeTimer timer(statistics, last_command);
+  const char *message_buffer;
+  uint32_t message_size;
+  if (!readFrame(message_buffer, message_size)) {
     return -1;
   }
-  LOG_LOGIC("read init announced message size: " << *message_size);
-  std::vector<char> message_buffer(*message_size);
-  const size_t count =
-      recv(sock, message_buffer.data(), *message_size, MSG_WAITALL);
-  LOG_LOGIC("read init received message size: " << count);
+  LOG_LOGIC("read init message size: " << message_size);
 
-  google::protobuf::io::ArrayInputStream arrayIn(message_buffer.data(),
-                                                 *message_size);
+  google::protobuf::io::ArrayInputStream arrayIn(message_buffer, message_size);
   google::protobuf::io::CodedInputStream codedIn(&arrayIn);
 
-  InitMessage init_message;
+  InitMessage &init_message = received_init;
   init_message.ParseFromCodedStream(&codedIn);
 
   return_value.start_time = init_message.start_time();
   return_value.end_time = init_message.end_time();
+  // ambassadors without protocol extensions do not send the field
+  return_value.capabilities = init_message.capabilities();
 
   LOG_INFO("read init start time: " << return_value.start_time);
   LOG_INFO("read init end time: " << return_value.end_time);
+  LOG_INFO("read init capabilities: " << return_value.capabilities);
 
   return 0;
 }
@@ -419,51 +627,46 @@ int ClientServerChannel::readInit(CSC_init_return &return_value) {
  */
 int ClientServerChannel::readUpdateNode(CSC_update_node_return &return_value) {
   LOG_FUNCTION(this);
-  const std::shared_ptr<uint32_t> message_size = readVarintPrefix(sock);
-  if (!message_size) {
-    return -1;
-  }
-  LOG_LOGIC("read update note announced message size: " << *message_size);
-  if (*message_size < 0) {
-    return 0;
+  const ChannelStatistics::DecodeTimer timer(statistics, last_command);
+  if (last_command == CMD_UPDATE_NODE_PACKED) {
+    if (batch_entry != nullptr) {
+      return convertUpdateNodePacked(batch_entry->update_node_packed(),
+                                     return_value);
+    }
+    const char *message_buffer;
+    uint32_t message_size;
+    if (!readFrame(message_buffer, message_size)) {
+      return -1;
+    }
+    LOG_LOGIC("read packed update node message size: " << message_size);
+    return decodeUpdateNodePacked(message_buffer, message_size, return_value);
   }
+  if (batch_entry == nullptr) {
+    const char *message_buffer;
+    uint32_t message_size;
+    if (!readFrame(message_buffer, message_size)) {
+      return -1;
+    }
+    LOG_LOGIC("read update node message size: " << message_size);
+    if (flat_messages) {
+      return flat::decodeUpdateNode(message_buffer, message_size,
+                                    return_value);
+    }
 
-  std::vector<char> message_buffer(*message_size);
-  const size_t count =
-      recv(sock, message_buffer.data(), *message_size, MSG_WAITALL);
-  LOG_LOGIC("read update node received message size: " << count);
-
-  if (*message_size != count) {
-    std::cerr << "ERROR: expected " << *message_size << " bytes, but red "
-              << count << " bytes!" << std::endl;
-    return -1;
+    google::protobuf::io::ArrayInputStream arrayIn(message_buffer,
+                                                   message_size);
+    google::protobuf::io::CodedInputStream codedIn(&arrayIn);
+    received_update_node.ParseFromCodedStream(&codedIn); // Parse message
   }
+  const UpdateNode &update_message = batch_entry != nullptr
+                                         ? batch_entry->update_node()
+                                         : received_update_node;
 
-  google::protobuf::io::ArrayInputStream arrayIn(message_buffer.data(),
-                                                 *message_size);
-  google::protobuf::io::CodedInputStream codedIn(&arrayIn);
-
-  UpdateNode update_message;
-  update_message.ParseFromCodedStream(&codedIn); // Parse message
-
-  switch (update_message.update_type()) { // Convert the types from protobuf
-                                          // enum to our update message types
-  case UpdateNode_UpdateType_ADD_RSU:
-    return_value.type = UPDATE_ADD_RSU;
-    break;
-  case UpdateNode_UpdateType_ADD_VEHICLE:
-    return_value.type = UPDATE_ADD_VEHICLE;
-    break;
-  case UpdateNode_UpdateType_MOVE_NODE:
-    return_value.type = UPDATE_MOVE_NODE;
-    break;
-  case UpdateNode_UpdateType_REMOVE_NODE:
-    return_value.type = UPDATE_REMOVE_NODE;
-    break;
-  default:
+  // Convert the types from protobuf enum to our update message types
+  return_value.type = protoUpdateTypeToUpdateType(update_message.update_type());
+  if (return_value.type == 0) {
     std::cerr << "ERROR: update type unknown: " << update_message.update_type()
               << std::endl;
-    return_value.type = (UPDATE_NODE_TYPE)0;
     return 1; // 1 signals an error
   }
   LOG_INFO("read update message update type " << return_value.type);
@@ -471,10 +674,13 @@ int ClientServerChannel::readUpdateNode(CSC_update_node_return &return_value) {
   return_value.time = update_message.time();
   LOG_INFO("read update message update time " << return_value.time);
 
-  for (size_t i = 0; i < update_message.properties_size();
+  // the caller may pass the same struct for every update, resizing keeps its
+  // capacity so that no allocation happens once the largest update was seen
+  return_value.properties.resize(update_message.properties_size());
+  for (int i = 0; i < update_message.properties_size();
        i++) { // fill the update messages into our struct
-    UpdateNode_NodeData node_data = update_message.properties(i);
-    CSC_node_data returned_node_data;
+    const UpdateNode_NodeData &node_data = update_message.properties(i);
+    CSC_node_data &returned_node_data = return_value.properties[i];
 
     returned_node_data.id = node_data.id();
     returned_node_data.x = node_data.x();
@@ -483,10 +689,193 @@ int ClientServerChannel::readUpdateNode(CSC_update_node_return &return_value) {
     LOG_INFO("read update message update node index="
              << i << " id=" << returned_node_data.id
              << " x=" << returned_node_data.x << " y=" << returned_node_data.y);
+  }
 
-    return_value.properties.push_back(returned_node_data);
+  return 0;
+}
+
+/**
+ * @brief Decodes an UpdateNodePacked message without a protobuf message object
+ *
+ * The packed arrays are read straight from the receive buffer into the
+ * properties of return_value, whose capacity is kept between updates. Ids are
+ * accumulated from their deltas and centimeter positions are scaled to meters.
+ * A message must not mix meter and centimeter positions. Unpacked encodings
+ * of the repeated fields are accepted as well, as protobuf parsers have to.
+ *
+ * @return 0 if successful
+ */
+int ClientServerChannel::decodeUpdateNodePacked(
+    const char *buffer, uint32_t size, CSC_update_node_return &return_value) {
+  using google::protobuf::internal::WireFormatLite;
+  google::protobuf::io::CodedInputStream in(
+      reinterpret_cast<const uint8_t *>(buffer), size);
+  std::vector<CSC_node_data> &nodes = return_value.properties;
+  nodes.clear();
+  const auto node = [&nodes](size_t index) -> CSC_node_data & {
+    if (index >= nodes.size()) {
+      nodes.resize(index + 1);
+    }
+    return nodes[index];
+  };
+  size_t num_ids = 0;
+  size_t num_x = 0;
+  size_t num_y = 0;
+  bool meters = false;
+  bool centimeters = false;
+  int64_t id = 0;
+  bool ids_in_range = true;
+  uint32_t update_type = 0;
+  uint64_t time = 0;
+  bool valid = true;
+  uint32_t tag;
+  while (valid && (tag = in.ReadTag()) != 0) {
+    const int wire_type = WireFormatLite::GetTagWireType(tag);
+    // reads a packed array or a single value of a repeated field
+    const auto values = [&](int value_wire_type, auto &&read_value) {
+      if (wire_type == value_wire_type) {
+        valid = read_value();
+        return;
+      }
+      uint32_t length;
+      if (wire_type != WireFormatLite::WIRETYPE_LENGTH_DELIMITED ||
+          !in.ReadVarint32(&length)) {
+        valid = false;
+        return;
+      }
+      const auto limit = in.PushLimit(length);
+      while (valid && in.BytesUntilLimit() > 0) {
+        valid = read_value();
+      }
+      in.PopLimit(limit);
+    };
+    const auto varint = [&](size_t &count, auto &&store) {
+      values(WireFormatLite::WIRETYPE_VARINT, [&]() {
+        uint64_t value;
+        if (!in.ReadVarint64(&value)) {
+          return false;
+        }
+        store(node(count++), value);
+        return true;
+      });
+    };
+    const auto fixed64 = [&](size_t &count, double CSC_node_data::*member) {
+      values(WireFormatLite::WIRETYPE_FIXED64, [&]() {
+        uint64_t value;
+        if (!in.ReadLittleEndian64(&value)) {
+          return false;
+        }
+        node(count++).*member = WireFormatLite::DecodeDouble(value);
+        return true;
+      });
+    };
+    switch (WireFormatLite::GetTagFieldNumber(tag)) {
+    case UpdateNodePacked::kUpdateTypeFieldNumber:
+      valid = wire_type == WireFormatLite::WIRETYPE_VARINT &&
+              in.ReadVarint32(&update_type);
+      break;
+    case UpdateNodePacked::kTimeFieldNumber:
+      valid = wire_type == WireFormatLite::WIRETYPE_VARINT &&
+              in.ReadVarint64(&time);
+      break;
+    case UpdateNodePacked::kIdDeltaFieldNumber:
+      varint(num_ids, [&](CSC_node_data &data, uint64_t value) {
+        id += WireFormatLite::ZigZagDecode32(static_cast<uint32_t>(value));
+        ids_in_range &= id >= INT32_MIN && id <= INT32_MAX;
+        data.id = static_cast<int32_t>(id);
+      });
+      break;
+    case UpdateNodePacked::kXFieldNumber:
+      meters = true;
+      fixed64(num_x, &CSC_node_data::x);
+      break;
+    case UpdateNodePacked::kYFieldNumber:
+      meters = true;
+      fixed64(num_y, &CSC_node_data::y);
+      break;
+    case UpdateNodePacked::kXCmFieldNumber:
+      centimeters = true;
+      varint(num_x, [](CSC_node_data &data, uint64_t value) {
+        data.x = WireFormatLite::ZigZagDecode64(value) / 100.0;
+      });
+      break;
+    case UpdateNodePacked::kYCmFieldNumber:
+      centimeters = true;
+      varint(num_y, [](CSC_node_data &data, uint64_t value) {
+        data.y = WireFormatLite::ZigZagDecode64(value) / 100.0;
+      });
+      break;
+    default:
+      valid = WireFormatLite::SkipField(&in, tag);
+    }
   }
+  return_value.type = protoUpdateTypeToUpdateType(update_type);
+  return_value.time = static_cast<int64_t>(time);
+  // positions may be omitted, e.g. when removing nodes
+  if (!valid || !ids_in_range || return_value.type == 0 ||
+      (meters && centimeters) || num_y != num_x ||
+      (num_x != 0 && num_x != num_ids)) {
+    std::cerr << "ERROR: packed update node message is invalid" << std::endl;
+    nodes.clear();
+    return 1;
+  }
+  LOG_INFO("read packed update message type " << return_value.type << " time "
+                                              << return_value.time << " for "
+                                              << num_ids << " nodes");
+  return 0;
+}
 
+/**
+ * Converts an UpdateNodePacked message that was already parsed, as it happens
+ * for entries of a command batch.
+ *
+ * @return 0 if successful
+ */
+int ClientServerChannel::convertUpdateNodePacked(
+    const UpdateNodePacked &update_message,
+    CSC_update_node_return &return_value) {
+  return_value.type = protoUpdateTypeToUpdateType(update_message.update_type());
+  return_value.time = update_message.time();
+  const int num_nodes = update_message.id_delta_size();
+  const bool meters =
+      update_message.x_size() > 0 || update_message.y_size() > 0;
+  const bool centimeters =
+      update_message.x_cm_size() > 0 || update_message.y_cm_size() > 0;
+  const int num_x =
+      centimeters ? update_message.x_cm_size() : update_message.x_size();
+  const int num_y =
+      centimeters ? update_message.y_cm_size() : update_message.y_size();
+  if (return_value.type == 0 || (meters && centimeters) || num_y != num_x ||
+      (num_x != 0 && num_x != num_nodes)) {
+    std::cerr << "ERROR: packed update node message is invalid" << std::endl;
+    return_value.properties.clear();
+    return 1;
+  }
+  return_value.properties.resize(num_nodes);
+  int64_t id = 0;
+  for (int i = 0; i < num_nodes; i++) {
+    CSC_node_data &node_data = return_value.properties[i];
+    id += update_message.id_delta(i);
+    if (id < INT32_MIN || id > INT32_MAX) {
+      std::cerr << "ERROR: packed update node message is invalid" << std::endl;
+      return_value.properties.clear();
+      return 1;
+    }
+    node_data.id = static_cast<int32_t>(id);
+    if (num_x == 0) {
+      node_data.x = 0;
+      node_data.y = 0;
+    } else if (centimeters) {
+      node_data.x = update_message.x_cm(i) / 100.0;
+      node_data.y = update_message.y_cm(i) / 100.0;
+    } else {
+      node_data.x = update_message.x(i);
+      node_data.y = update_message.y(i);
+    }
+  }
+  LOG_INFO("read packed update message type " << return_value.type << " time "
+                                              << return_value.time << " for "
+                                              << num_nodes << " nodes");
   return 0;
 }
 
@@ -497,22 +886,18 @@ int ClientServerChannel::readUpdateNode(CSC_update_node_return &return_value) {
  */
 int64_t ClientServerChannel::readTimeMessage() {
   LOG_FUNCTION(this);
-  const std::shared_ptr<uint32_t> message_size = readVarintPrefix(sock);
-  if (!message_size) {
+  const ChannelStatistics::DecodeTimer timer(statistics, last_command);
+  const char *message_buffer;
+  uint32_t message_size;
+  if (!readFrame(message_buffer, message_size)) {
     return -1;
   }
-  LOG_LOGIC("read time announced message size: " << *message_size);
+  LOG_LOGIC("read time message size: " << message_size);
 
-  std::vector<char> message_buffer(*message_size);
-  const size_t count =
-      recv(sock, message_buffer.data(), *message_size, MSG_WAITALL);
-  LOG_LOGIC("read time received message size: " << count);
-
-  google::protobuf::io::ArrayInputStream arrayIn(message_buffer.data(),
-                                                 *message_size);
+  google::protobuf::io::ArrayInputStream arrayIn(message_buffer, message_size);
   google::protobuf::io::CodedInputStream codedIn(&arrayIn);
 
-  TimeMessage time_message;
+  TimeMessage &time_message = received_time;
   time_message.ParseFromCodedStream(&codedIn);
 
   int64_t time = time_message.time();
@@ -529,23 +914,22 @@ int64_t ClientServerChannel::readTimeMessage() {
 int ClientServerChannel::readConfigurationMessage(
     CSC_config_message &return_value) {
   LOG_FUNCTION(this);
-  const std::shared_ptr<uint32_t> message_size = readVarintPrefix(sock);
-  if (!message_size) {
-    return -1;
-  }
-  LOG_LOGIC("read config announced message size: " << *message_size);
-
-  std::vector<char> message_buffer(*message_size);
-  const size_t count =
-      recv(sock, message_buffer.data(), *message_size, MSG_WAITALL);
-  LOG_LOGIC("read config received message size: " << count);
-
-  google::protobuf::io::ArrayInputStream arrayIn(message_buffer.data(),
-                                                 *message_size);
-  google::protobuf::io::CodedInputStream codedIn(&arrayIn);
+  const ChannelStatistics::DecodeTimer timer(statistics, last_command);
+  if (batch_entry == nullptr) {
+    const char *message_buffer;
+    uint32_t message_size;
+    if (!readFrame(message_buffer, message_size)) {
+      return -1;
+    }
+    LOG_LOGIC("read config message size: " << message_size);
 
-  ConfigureRadioMessage conf_message;
-  conf_message.ParseFromCodedStream(&codedIn);
+    google::protobuf::io::ArrayInputStream arrayIn(message_buffer,
+                                                   message_size);
+    google::protobuf::io::CodedInputStream codedIn(&arrayIn);
+    received_config.ParseFromCodedStream(&codedIn);
+  }
+  const ConfigureRadioMessage &conf_message =
+      batch_entry != nullptr ? batch_entry->configure_radio() : received_config;
 
   return_value.time = conf_message.time();
   return_value.msg_id = conf_message.message_id();
@@ -650,7 +1034,10 @@ int ClientServerChannel::readConfigurationMessage(
                << return_value.secondary_radio.secondary_channel);
     }
   }
-  writeCommand(CMD_SUCCESS);
+  // a batch is acknowledged once as a whole, pipelined commands not at all
+  if (acknowledge_commands && batch_entry == nullptr) {
+    writeCommand(CMD_SUCCESS);
+  }
 
   return 0;
 }
@@ -663,24 +1050,38 @@ int ClientServerChannel::readConfigurationMessage(
  */
 int ClientServerChannel::readSendMessage(CSC_send_message &return_value) {
   LOG_FUNCTION(this);
-  std::shared_ptr<uint32_t> message_size = readVarintPrefix(sock);
-  if (!message_size) {
-    return -1;
-  }
-  LOG_LOGIC("read send announced message size: " << *message_size);
-
-  std::vector<char> message_buffer(*message_size);
-  const size_t count =
-      recv(sock, message_buffer.data(), *message_size, MSG_WAITALL);
-  LOG_LOGIC("read send received message size: " << count);
-
-  google::protobuf::io::ArrayInputStream arrayIn(message_buffer.data(),
-                                                 *message_size);
-  google::protobuf::io::CodedInputStream codedIn(&arrayIn);
+  const ChannelStatistics::DecodeTimer timer(statistics, last_command);
+  if (batch_entry == nullptr) {
+    const char *message_buffer;
+    uint32_t message_size;
+    if (!readFrame(message_buffer, message_size)) {
+      return -1;
+    }
+    LOG_LOGIC("read send message size: " << message_size);
+    if (flat_messages) {
+      if (flat::decodeSendMessage(message_buffer, message_size,
+                                  return_value) != 0) {
+        return 1;
+      }
+      if (acknowledge_commands) {
+        writeCommand(CMD_SUCCESS);
+      }
+      return 0;
+    }
 
-  SendMessageMessage send_message;
-  send_message.ParseFromCodedStream(&codedIn);
+    google::protobuf::io::ArrayInputStream arrayIn(message_buffer,
+                                                   message_size);
+    google::protobuf::io::CodedInputStream codedIn(&arrayIn);
+    received_send_message.ParseFromCodedStream(&codedIn);
+  }
+  const SendMessageMessage &send_message = batch_entry != nullptr
+                                               ? batch_entry->send_message()
+                                               : received_send_message;
 
+  if (send_message.node_id() > INT_MAX || send_message.message_id() > INT_MAX) {
+    std::cerr << "ERROR: send message ids exceed the range of int" << std::endl;
+    return 1;
+  }
   return_value.time = send_message.time();
   return_value.node_id = send_message.node_id();
 
@@ -720,11 +1121,73 @@ int ClientServerChannel::readSendMessage(CSC_send_message &return_value) {
     LOG_INFO("read send message topo address ttl: "
              << return_value.topo_address.ttl);
   }
-  writeCommand(CMD_SUCCESS);
+  // a batch is acknowledged once as a whole, pipelined commands not at all
+  if (acknowledge_commands && batch_entry == nullptr) {
+    writeCommand(CMD_SUCCESS);
+  }
 
   return 0;
 }
 
+/**
+ * Reads a batch of commands from the channel. The entries are then iterated
+ * with readBatchCommand and decoded in place by the read method matching each
+ * entry, so the batch is not copied.
+ *
+ * @return 0 if successful
+ */
+int ClientServerChannel::readCommandBatch() {
+  LOG_FUNCTION(this);
+  const ChannelStatistics::DecodeTimer timer(statistics, last_command);
+  batch_index = 0;
+  batch_entry = nullptr;
+  const char *message_buffer;
+  uint32_t message_size;
+  if (!readFrame(message_buffer, message_size)) {
+    received_command_batch.Clear();
+    return -1;
+  }
+  LOG_LOGIC("read command batch message size: " << message_size);
+
+  google::protobuf::io::ArrayInputStream arrayIn(message_buffer, message_size);
+  google::protobuf::io::CodedInputStream codedIn(&arrayIn);
+  if (!received_command_batch.ParseFromCodedStream(&codedIn)) {
+    std::cerr << "ERROR: command batch could not be parsed" << std::endl;
+    received_command_batch.Clear();
+    return 1;
+  }
+  LOG_INFO("read command batch entries: "
+           << received_command_batch.entries_size());
+  return 0;
+}
+
+/**
+ * Selects the next entry of the batch read by readCommandBatch.
+ *
+ * @return command of the entry, CMD_UNDEF once all entries were returned
+ */
+CMD ClientServerChannel::readBatchCommand() {
+  LOG_FUNCTION(this);
+  while (batch_index < received_command_batch.entries_size()) {
+    batch_entry = &received_command_batch.entries(batch_index++);
+    switch (batch_entry->command_case()) {
+    case CommandBatch_Entry::kUpdateNode:
+      return last_command = CMD_UPDATE_NODE;
+    case CommandBatch_Entry::kUpdateNodePacked:
+      return last_command = CMD_UPDATE_NODE_PACKED;
+    case CommandBatch_Entry::kSendMessage:
+      return last_command = CMD_MSG_SEND;
+    case CommandBatch_Entry::kConfigureRadio:
+      return last_command = CMD_CONF_RADIO;
+    default:
+      std::cerr << "ERROR: command batch entry " << batch_index - 1
+                << " is empty" << std::endl;
+    }
+  }
+  batch_entry = nullptr;
+  return last_command = CMD_UNDEF;
+}
+
 // #####################################################
 //   Public write-methods
 // #####################################################
@@ -739,97 +1202,319 @@ void ClientServerChannel::writeCommand(CMD cmd) {
   LOG_FUNCTION(this << cmd);
   CommandMessage commandMessage;
   commandMessage.set_command_type(cmdToProtoCMD(cmd));
-  int varintsize = google::protobuf::io::CodedOutputStream::VarintSize32(
-      commandMessage.ByteSizeLong());
-  LOG_LOGIC("write command varint size: " << varintsize);
-  int buffer_size = varintsize + commandMessage.ByteSizeLong();
-  LOG_LOGIC("write command buffer size: " << buffer_size);
-  std::vector<char> message_buffer(buffer_size);
-
-  google::protobuf::io::ArrayOutputStream arrayOut(message_buffer.data(),
-                                                   buffer_size);
-  google::protobuf::io::CodedOutputStream codedOut(&arrayOut);
-
-  codedOut.WriteVarint32(commandMessage.ByteSizeLong());
-  commandMessage.SerializeToCodedStream(&codedOut);
-  const size_t count = send(sock, message_buffer.data(), buffer_size, 0);
-  LOG_LOGIC("write command send bytes: " << count);
+  written_command = cmd;
+  if (statistics != nullptr) {
+    statistics->command(cmd).sent++;
+  }
+  writeMessage(commandMessage);
 }
 
 void ClientServerChannel::writeReceiveMessage(uint64_t time, int node_id,
                                               int message_id,
                                               RADIO_CHANNEL channel, int rssi) {
   LOG_FUNCTION(this << time << node_id << message_id << channel << rssi);
+  if (flat_messages) {
+    char flat_message[flat::RECEIVE_MESSAGE_SIZE];
+    flat::encodeReceiveMessage(time, node_id, message_id, channel, rssi,
+                               flat_message);
+    writeFrame(flat_message, sizeof(flat_message));
+    return;
+  }
   ReceiveMessage receive_message;
   receive_message.set_time(time);
   receive_message.set_node_id(node_id);
   receive_message.set_message_id(message_id);
   receive_message.set_channel_id(channelToProtoChannel(channel));
   receive_message.set_rssi(rssi);
-  int varintsize = google::protobuf::io::CodedOutputStream::VarintSize32(
-      receive_message.ByteSizeLong());
-  LOG_LOGIC("write receive message varint size: " << varintsize);
-  int buffer_size = varintsize + receive_message.ByteSizeLong();
-  LOG_LOGIC("write receive message buffer size: " << buffer_size);
-  std::vector<char> message_buffer(buffer_size);
+  writeMessage(receive_message);
+}
+
+/**
+ * Adds a reception to the batch of the current time advance. Receptions of the
+ * same message on the same channel share one group, so a broadcast heard by
+ * many nodes costs a few bytes per receiver instead of two frames.
+ */
+void ClientServerChannel::addReceiveMessage(uint64_t time, int node_id,
+                                            int message_id,
+                                            RADIO_CHANNEL channel, int rssi) {
+  LOG_FUNCTION(this << time << node_id << message_id << channel << rssi);
+  // through uint32_t, a negative id must not sign extend over the channel
+  const uint64_t key =
+      (static_cast<uint64_t>(static_cast<uint32_t>(message_id)) << 8) | channel;
+  auto inserted =
+      receive_batch_groups.emplace(key, receive_batch.receptions_size());
+  if (inserted.second) {
+    ReceiveMessageBatch_Receptions *group = receive_batch.add_receptions();
+    group->set_message_id(message_id);
+    group->set_channel_id(channelToProtoChannel(channel));
+  }
+  ReceiveMessageBatch_Receptions *group =
+      receive_batch.mutable_receptions(inserted.first->second);
+  group->add_node_id(node_id);
+  group->add_time(time);
+  // rssi is only sent once a reception of the group has a measured value
+  if (group->rssi_size() == 0 && rssi != 0) {
+    for (int i = 1; i < group->node_id_size(); i++) {
+      group->add_rssi(0);
+    }
+  }
+  if (group->rssi_size() > 0 || rssi != 0) {
+    group->add_rssi(rssi);
+  }
+}
+
+/**
+ * Writes the receptions added since the last call as one CMD_MSG_RECV_BATCH.
+ * Clearing keeps the allocated groups of the batch for the next time advance.
+ */
+void ClientServerChannel::writeReceiveMessageBatch() {
+  LOG_FUNCTION(this);
+  if (receive_batch.receptions_size() == 0) {
+    return;
+  }
+  LOG_INFO("write receive message batch with "
+           << receive_batch.receptions_size() << " messages");
+  writeCommand(CMD_MSG_RECV_BATCH);
+  writeMessage(receive_batch);
+  receive_batch.Clear();
+  receive_batch_groups.clear();
+}
+
+void ClientServerChannel::writeMobilityInterest(
+    const std::vector<int> &subscribe, const std::vector<int> &unsubscribe) {
+  LOG_FUNCTION(this << subscribe.size() << unsubscribe.size());
+  MobilityInterest interest_message;
+  interest_message.mutable_subscribe()->Assign(subscribe.begin(),
+                                               subscribe.end());
+  interest_message.mutable_unsubscribe()->Assign(unsubscribe.begin(),
+                                                 unsubscribe.end());
+  writeCommand(CMD_MOBILITY_INTEREST);
+  writeMessage(interest_message);
+}
+
+/**
+ * Reports a command that could not be executed. In pipelined mode the
+ * Ambassador does not wait for an acknowledgement of each command, it reads
+ * these reports together with NEXT_EVENT and END instead.
+ */
+void ClientServerChannel::writeCommandError(CMD cmd, int64_t time,
+                                            const std::string &description) {
+  LOG_FUNCTION(this << cmd << time << description);
+  CommandErrorMessage error_message;
+  error_message.set_command_type(cmdToProtoCMD(cmd));
+  error_message.set_time(time);
+  error_message.set_description(description);
+  writeCommand(CMD_ERROR);
+  writeMessage(error_message);
+}
 
-  google::protobuf::io::ArrayOutputStream arrayOut(message_buffer.data(),
-                                                   buffer_size);
-  google::protobuf::io::CodedOutputStream codedOut(&arrayOut);
+/**
+ * Switches to frames with a flag byte, see FrameCompression. Frames written
+ * before are not affected, so the SUCCESS of CMD_INIT is written first.
+ */
+void ClientServerChannel::enableCompression(size_t threshold) {
+  delete compression;
+  compression = new FrameCompression(threshold);
+}
 
-  codedOut.WriteVarint32(receive_message.ByteSizeLong());
-  receive_message.SerializeToCodedStream(&codedOut);
-  const size_t count = send(sock, message_buffer.data(), buffer_size, 0);
-  LOG_LOGIC("write receive message send bytes: " << count);
+const FrameCompression *ClientServerChannel::getCompression() const {
+  return compression;
+}
+
+void ClientServerChannel::enableStatistics() {
+  if (statistics == nullptr) {
+    statistics = new ChannelStatistics();
+  }
+}
+
+const ChannelStatistics *ClientServerChannel::getStatistics() const {
+  return statistics;
+}
+
+bool ClientServerChannel::enableRecording(std::string trace_path) {
+  delete recording;
+  recording = new FrameTraceWriter();
+  return recording->open(trace_path);
+}
+
+void ClientServerChannel::setFlatMessages(bool flat) { flat_messages = flat; }
+
+void ClientServerChannel::setAcknowledgeCommands(bool acknowledge) {
+  acknowledge_commands = acknowledge;
 }
 
 void ClientServerChannel::writeTimeMessage(int64_t time) {
   LOG_FUNCTION(this << time);
   TimeMessage time_message;
   time_message.set_time(time);
-  int varintsize = google::protobuf::io::CodedOutputStream::VarintSize32(
-      time_message.ByteSizeLong());
-  LOG_LOGIC("write time message varint size: " << varintsize);
-  int buffer_size = varintsize + time_message.ByteSizeLong();
-  LOG_LOGIC("write time message buffer size: " << buffer_size);
-  std::vector<char> message_buffer(buffer_size);
-
-  google::protobuf::io::ArrayOutputStream arrayOut(message_buffer.data(),
-                                                   buffer_size);
-  google::protobuf::io::CodedOutputStream codedOut(&arrayOut);
-
-  codedOut.WriteVarint32(time_message.ByteSizeLong());
-  time_message.SerializeToCodedStream(&codedOut);
-  const size_t count = send(sock, message_buffer.data(), buffer_size, 0);
-  LOG_LOGIC("write time message send bytes: " << count);
+  writeMessage(time_message);
 }
 
-void ClientServerChannel::writePort(uint32_t port) {
-  LOG_FUNCTION(this << port);
+void ClientServerChannel::writePort(uint32_t port, uint32_t capabilities,
+                                    double move_epsilon) {
+  LOG_FUNCTION(this << port << capabilities << move_epsilon);
   PortExchange port_exchange;
   port_exchange.set_port_number(port);
+  if (capabilities != 0) {
+    port_exchange.set_capabilities(capabilities);
+  }
+  if (move_epsilon > 0) {
+    port_exchange.set_move_epsilon(move_epsilon);
+  }
   LOG_LOGIC("write port exchange: " << port_exchange.port_number());
-  int varintsize = google::protobuf::io::CodedOutputStream::VarintSize32(
-      port_exchange.ByteSizeLong());
-  LOG_LOGIC("write port message varint size: " << varintsize);
-  int buffer_size = varintsize + port_exchange.ByteSizeLong();
-  LOG_LOGIC("write port message buffer size: " << buffer_size);
-  std::vector<char> message_buffer(buffer_size);
+  writeMessage(port_exchange);
+}
 
-  google::protobuf::io::ArrayOutputStream arrayOut(message_buffer.data(),
-                                                   buffer_size);
-  google::protobuf::io::CodedOutputStream codedOut(&arrayOut);
+/**
+ * Sends all messages written since the last flush with a single send call.
+ * Blocks until the whole output buffer has been handed to the socket.
+ */
+void ClientServerChannel::flush() {
+  LOG_FUNCTION(this);
+  if (replaying) {
+    // there is nobody to answer in a replay
+    send_buffer.clear();
+    return;
+  }
+  const uint64_t start = statistics != nullptr && !send_buffer.empty()
+                             ? ChannelStatistics::now()
+                             : 0;
+  if (!send_buffer.empty()) {
+    FlightRecorder::record(FLIGHT_FLUSH, written_command, send_buffer.size(),
+                           0);
+  }
+  size_t offset = 0;
+  while (offset < send_buffer.size()) {
+    const ssize_t count =
+        shm != nullptr
+            ? shm->send(send_buffer.data() + offset,
+                        send_buffer.size() - offset)
+            : send(sock, send_buffer.data() + offset,
+                   send_buffer.size() - offset, MSG_NOSIGNAL);
+    if (count < 0) {
+      if (errno == EINTR && shm == nullptr) {
+        continue;
+      }
+      std::cerr << "ERROR: ClientServerChannel could not send to Ambassador - "
+                << strerror(errno) << std::endl;
+      break;
+    }
+    LOG_LOGIC("flush send bytes: " << count);
+    offset += count;
+  }
+  if (start != 0) {
+    statistics->flushed(offset, ChannelStatistics::now() - start);
+  }
+  send_buffer.clear();
+}
 
-  codedOut.WriteVarint32(port_exchange.ByteSizeLong());
-  port_exchange.SerializeToCodedStream(&codedOut);
-  const size_t count = send(sock, message_buffer.data(), buffer_size, 0);
-  LOG_LOGIC("write port message send bytes: " << count);
+/**
+ * Wakes a thread blocked in a read of this channel. Sockets stay writable, a
+ * shared memory channel is closed as a whole.
+ */
+void ClientServerChannel::shutdownReceive() {
+  receive_shutdown = true;
+  if (replay != nullptr) {
+    replay->shutdown();
+  } else if (shm != nullptr) {
+    shm->shutdown();
+  } else if (sock >= 0) {
+    ::shutdown(sock, SHUT_RD);
+  }
 }
 
 // #####################################################
 //   Private helpers
 // #####################################################
 
+/**
+ * @brief Ensures that at least the given number of bytes is buffered
+ *
+ * Reads from the socket into the free space of the receive buffer until enough
+ * bytes are available. Each recv call asks for the whole free space, so
+ * several frames sent back to back by the Ambassador are fetched with a single
+ * system call. The buffer is compacted or grown if the remaining space is too
+ * small for the requested amount.
+ *
+ * @param num_bytes number of bytes needed behind the current read position
+ * @return true if the bytes are available, false if the socket failed
+ */
+bool ClientServerChannel::fillReceiveBuffer(size_t num_bytes) {
+  if (recv_end - recv_begin >= num_bytes) {
+    return true;
+  }
+  if (recv_begin + num_bytes > recv_buffer.size()) {
+    // move pending bytes to the front and grow if the frame does not fit
+    std::memmove(recv_buffer.data(), recv_buffer.data() + recv_begin,
+                 recv_end - recv_begin);
+    recv_end -= recv_begin;
+    recv_begin = 0;
+    if (num_bytes > recv_buffer.size()) {
+      recv_buffer.resize(std::max(num_bytes, 2 * recv_buffer.size()));
+    }
+  }
+  // Pending output has to reach the Ambassador before we wait for its answer
+  if (!send_buffer.empty()) {
+    flush();
+  }
+  FlightRecorder::record(FLIGHT_RECEIVE, last_command,
+                         num_bytes - (recv_end - recv_begin), 0);
+  const uint64_t start = statistics != nullptr ? ChannelStatistics::now() : 0;
+  while (recv_end - recv_begin < num_bytes) {
+    const ssize_t count =
+        shm != nullptr
+            ? shm->receive(recv_buffer.data() + recv_end,
+                           recv_buffer.size() - recv_end)
+            : receiveFromSocket(recv_buffer.data() + recv_end,
+                                recv_buffer.size() - recv_end);
+    if (count <= 0) {
+      if (count < 0 && errno == EINTR) {
+        continue;
+      }
+      if (receive_shutdown) {
+        return false;
+      }
+      std::cerr << "ERROR: ClientServerChannel could not receive from "
+                   "Ambassador - "
+                << (count == 0 ? "connection closed" : strerror(errno))
+                << std::endl;
+      return false;
+    }
+    LOG_LOGIC("fillReceiveBuffer received bytes: " << count);
+    recv_end += count;
+  }
+  if (statistics != nullptr) {
+    receive_blocked_ns += ChannelStatistics::now() - start;
+  }
+  return true;
+}
+
+/**
+ * Receives what is available, up to max_bytes. With busy_poll the socket is
+ * polled with non-blocking reads first, so that an answer arriving within that
+ * time does not pay for putting the thread to sleep and waking it up.
+ */
+ssize_t ClientServerChannel::receiveFromSocket(char *buffer, size_t max_bytes) {
+  if (busy_poll.count() > 0) {
+    const auto deadline = std::chrono::steady_clock::now() + busy_poll;
+    do {
+      const ssize_t count = recv(sock, buffer, max_bytes, MSG_DONTWAIT);
+      if (count >= 0 || (errno != EAGAIN && errno != EWOULDBLOCK)) {
+        return count;
+      }
+    } while (std::chrono::steady_clock::now() < deadline && !receive_shutdown);
+  }
+  return recv(sock, buffer, max_bytes, 0);
+}
+
+void ClientServerChannel::applySocketOption(int fd, int level, int option,
+                                            int value, const char *name) {
+  if (setsockopt(fd, level, option, &value, sizeof(value)) < 0) {
+    std::cerr << "Warn: ClientServerChannel could not set " << name
+              << " on socket to Ambassador - " << strerror(errno) << std::endl;
+  }
+}
+
 /**
  * @brief Reads a variable length integer from the channel
  *
@@ -838,37 +1523,154 @@ void ClientServerChannel::writePort(uint32_t port) {
  * will be a variable length integer sent. This method reads such an integer of
  * variable length
  *
+ * @param return_value the decoded integer
+ * @return true if successful
  */
-std::shared_ptr<uint32_t> ClientServerChannel::readVarintPrefix(SOCKET sock) {
-  LOG_FUNCTION(this << sock);
-  int num_bytes = 0;
-  char current_byte;
+bool ClientServerChannel::readVarintPrefix(uint32_t &return_value) {
+  LOG_FUNCTION(this);
+  return_value = 0;
+  for (int num_bytes = 0; num_bytes < 4; num_bytes++) {
+    if (!fillReceiveBuffer(1)) { // If we could not read one byte, return error
+      return false;
+    }
+    const char current_byte = recv_buffer[recv_begin++];
+    return_value |= (current_byte & 0x7F)
+                    << (7 * num_bytes); // We get effectively 7 bits per byte
+    if (!(current_byte & 0x80)) { // as long as the msb is set, there comes
+                                  // another byte
+      LOG_LOGIC("readVarintPrefix return value: " << return_value);
+      return true;
+    }
+  }
+  return false; // too many bytes
+}
 
-  // first receive one byte from the channel
-  const size_t count = recv(sock, &current_byte, 1, 0);
+/**
+ * @brief Reads a length prefixed message from the channel
+ *
+ * The returned pointer refers to the receive buffer and stays valid until the
+ * next read on this channel.
+ *
+ * @param frame set to the first byte of the message body
+ * @param frame_size set to the size of the message body
+ * @return true if successful
+ */
+bool ClientServerChannel::readFrame(const char *&frame, uint32_t &frame_size) {
+  if (replaying) {
+    return readReplayFrame(frame, frame_size);
+  }
+  if (!readVarintPrefix(frame_size) || !fillReceiveBuffer(frame_size)) {
+    return false;
+  }
+  frame = recv_buffer.data() + recv_begin;
+  recv_begin += frame_size;
+  if (compression != nullptr && !compression->readFrame(frame, frame_size)) {
+    std::cerr << "ERROR: ClientServerChannel could not decode a compressed "
+                 "frame"
+              << std::endl;
+    return false;
+  }
+  if (recording != nullptr) {
+    recording->write(frame, frame_size);
+  }
+  // the frame of a command itself is counted by readCommand
+  if (last_command != CMD_UNDEF) {
+    if (statistics != nullptr) {
+      statistics->command(last_command).bytes_in += frame_size;
+    }
+    FlightRecorder::record(FLIGHT_FRAME_IN, last_command, frame_size, 0);
+  }
+  return true;
+}
 
-  num_bytes++;
-  if (count < 0) { // If we could not read one byte, return error
-    return std::shared_ptr<uint32_t>();
+/**
+ * Takes the next frame from the replayed trace. It points into the mapping of
+ * the trace, so it is neither copied nor decompressed. Pacing the frames
+ * counts as time blocked in receive.
+ */
+bool ClientServerChannel::readReplayFrame(const char *&frame,
+                                          uint32_t &frame_size) {
+  const uint64_t start = statistics != nullptr ? ChannelStatistics::now() : 0;
+  if (replay == nullptr || !replay->next(frame, frame_size)) {
+    if (!receive_shutdown) {
+      std::cerr << "ERROR: ClientServerChannel reached the end of the "
+                   "replayed trace"
+                << std::endl;
+    }
+    return false;
   }
-  int return_value = (current_byte & 0x7f); // We get effectively 7 bits per
-                                            // byte
-  while (current_byte &
-         0x80) { // as long as the msb is set, there comes another byte
-    current_byte = 0;
-    const size_t count = recv(sock, &current_byte, 1, 0); // receive another
-                                                          // byte
-    num_bytes++;
-    if (count < 0 ||
-        num_bytes >
-            4) { // If we have too many bytes or reading failed return error
-      return std::shared_ptr<uint32_t>();
+  if (statistics != nullptr) {
+    receive_blocked_ns += ChannelStatistics::now() - start;
+    if (last_command != CMD_UNDEF) {
+      statistics->command(last_command).bytes_in += frame_size;
     }
-    return_value |= (current_byte & 0x7F)
-                    << (7 * (num_bytes - 1)); // Add the next 7 bits
   }
-  LOG_LOGIC("readVarintPrefix return value: " << return_value);
-  return std::make_shared<uint32_t>(return_value);
+  if (last_command != CMD_UNDEF) {
+    FlightRecorder::record(FLIGHT_FRAME_IN, last_command, frame_size, 0);
+  }
+  return true;
+}
+
+/**
+ * @brief Appends a length prefixed message to the output buffer
+ *
+ * Messages are not sent immediately but collected until flush() is called,
+ * either explicitly or before the channel blocks waiting for input. This keeps
+ * the bytes on the wire unchanged while sending them with fewer system calls.
+ * Once compression is enabled, the frame is written by FrameCompression.
+ *
+ * @param message the protobuf message to be written
+ */
+void ClientServerChannel::writeMessage(
+    const google::protobuf::MessageLite &message) {
+  const size_t offset = send_buffer.size();
+  if (compression != nullptr) {
+    compression->writeFrame(message, send_buffer);
+    countWritten(offset);
+    return;
+  }
+  const size_t message_size = message.ByteSizeLong();
+  const size_t varint_size =
+      google::protobuf::io::CodedOutputStream::VarintSize32(message_size);
+  LOG_LOGIC("write message buffer size: " << varint_size + message_size);
+  send_buffer.resize(offset + varint_size + message_size);
+  uint8_t *target = reinterpret_cast<uint8_t *>(send_buffer.data() + offset);
+  target = google::protobuf::io::CodedOutputStream::WriteVarint32ToArray(
+      message_size, target);
+  message.SerializeWithCachedSizesToArray(target);
+  countWritten(offset);
+}
+
+/**
+ * @brief Appends a length prefixed frame that is not a protobuf message
+ */
+void ClientServerChannel::writeFrame(const char *data, size_t size) {
+  const size_t offset = send_buffer.size();
+  if (compression != nullptr) {
+    compression->writeFrame(data, size, send_buffer);
+    countWritten(offset);
+    return;
+  }
+  const size_t varint_size =
+      google::protobuf::io::CodedOutputStream::VarintSize32(size);
+  send_buffer.resize(offset + varint_size + size);
+  uint8_t *target = reinterpret_cast<uint8_t *>(send_buffer.data() + offset);
+  target = google::protobuf::io::CodedOutputStream::WriteVarint32ToArray(
+      size, target);
+  std::memcpy(target, data, size);
+  countWritten(offset);
+}
+
+/**
+ * Adds the frame appended from begin on to the command written last. Sizes
+ * include the prefixes here, as they are taken from the output buffer.
+ */
+void ClientServerChannel::countWritten(size_t begin) {
+  const size_t frame_size = send_buffer.size() - begin;
+  if (statistics != nullptr) {
+    statistics->command(written_command).bytes_out += frame_size;
+  }
+  FlightRecorder::record(FLIGHT_FRAME_OUT, written_command, frame_size, 0);
 }
 
 CommandMessage_CommandType ClientServerChannel::cmdToProtoCMD(CMD cmd) {
@@ -877,6 +1679,8 @@ CommandMessage_CommandType ClientServerChannel::cmdToProtoCMD(CMD cmd) {
     return CommandMessage_CommandType_UNDEF;
   case CMD_SUCCESS:
     return CommandMessage_CommandType_SUCCESS;
+  case CMD_ERROR:
+    return CommandMessage_CommandType_ERROR;
   case CMD_INIT:
     return CommandMessage_CommandType_INIT;
   case CMD_SHUT_DOWN:
@@ -886,6 +1690,10 @@ CommandMessage_CommandType ClientServerChannel::cmdToProtoCMD(CMD cmd) {
     return CommandMessage_CommandType_UPDATE_NODE;
   case CMD_REMOVE_NODE:
     return CommandMessage_CommandType_REMOVE_NODE;
+  case CMD_UPDATE_NODE_PACKED:
+    return CommandMessage_CommandType_UPDATE_NODE_PACKED;
+  case CMD_MOBILITY_INTEREST:
+    return CommandMessage_CommandType_MOBILITY_INTEREST;
 
   case CMD_ADVANCE_TIME:
     return CommandMessage_CommandType_ADVANCE_TIME;
@@ -893,6 +1701,8 @@ CommandMessage_CommandType ClientServerChannel::cmdToProtoCMD(CMD cmd) {
     return CommandMessage_CommandType_NEXT_EVENT;
   case CMD_MSG_RECV:
     return CommandMessage_CommandType_MSG_RECV;
+  case CMD_MSG_RECV_BATCH:
+    return CommandMessage_CommandType_MSG_RECV_BATCH;
 
   case CMD_MSG_SEND:
     return CommandMessage_CommandType_MSG_SEND;
@@ -901,6 +1711,8 @@ CommandMessage_CommandType ClientServerChannel::cmdToProtoCMD(CMD cmd) {
 
   case CMD_END:
     return CommandMessage_CommandType_END;
+  case CMD_COMMAND_BATCH:
+    return CommandMessage_CommandType_COMMAND_BATCH;
 
   default:
     return CommandMessage_CommandType_UNDEF;
@@ -913,6 +1725,8 @@ CMD ClientServerChannel::protoCMDToCMD(CommandMessage_CommandType cmd) {
     return CMD_UNDEF;
   case CommandMessage_CommandType_SUCCESS:
     return CMD_SUCCESS;
+  case CommandMessage_CommandType_ERROR:
+    return CMD_ERROR;
   case CommandMessage_CommandType_INIT:
     return CMD_INIT;
   case CommandMessage_CommandType_SHUT_DOWN:
@@ -922,6 +1736,10 @@ CMD ClientServerChannel::protoCMDToCMD(CommandMessage_CommandType cmd) {
     return CMD_UPDATE_NODE;
   case CommandMessage_CommandType_REMOVE_NODE:
     return CMD_REMOVE_NODE;
+  case CommandMessage_CommandType_UPDATE_NODE_PACKED:
+    return CMD_UPDATE_NODE_PACKED;
+  case CommandMessage_CommandType_MOBILITY_INTEREST:
+    return CMD_MOBILITY_INTEREST;
 
   case CommandMessage_CommandType_ADVANCE_TIME:
     return CMD_ADVANCE_TIME;
@@ -929,6 +1747,8 @@ CMD ClientServerChannel::protoCMDToCMD(CommandMessage_CommandType cmd) {
     return CMD_NEXT_EVENT;
   case CommandMessage_CommandType_MSG_RECV:
     return CMD_MSG_RECV;
+  case CommandMessage_CommandType_MSG_RECV_BATCH:
+    return CMD_MSG_RECV_BATCH;
 
   case CommandMessage_CommandType_MSG_SEND:
     return CMD_MSG_SEND;
@@ -937,12 +1757,30 @@ CMD ClientServerChannel::protoCMDToCMD(CommandMessage_CommandType cmd) {
 
   case CommandMessage_CommandType_END:
     return CMD_END;
+  case CommandMessage_CommandType_COMMAND_BATCH:
+    return CMD_COMMAND_BATCH;
 
   default:
     return CMD_UNDEF;
   }
 }
 
+UPDATE_NODE_TYPE
+ClientServerChannel::protoUpdateTypeToUpdateType(int protoType) {
+  switch (protoType) {
+  case UpdateNode_UpdateType_ADD_RSU:
+    return UPDATE_ADD_RSU;
+  case UpdateNode_UpdateType_ADD_VEHICLE:
+    return UPDATE_ADD_VEHICLE;
+  case UpdateNode_UpdateType_MOVE_NODE:
+    return UPDATE_MOVE_NODE;
+  case UpdateNode_UpdateType_REMOVE_NODE:
+    return UPDATE_REMOVE_NODE;
+  default:
+    return (UPDATE_NODE_TYPE)0;
+  }
+}
+
 RADIO_CHANNEL
 ClientServerChannel::protoChannelToChannel(RadioChannel protoChannel) {
   switch (protoChannel) {
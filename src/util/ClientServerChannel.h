@@ -26,7 +26,10 @@
 #undef NaN
 #include "ClientServerChannelMessages.pb.h"
 
-#include <memory> // shared_ptr
+#include <atomic>
+#include <chrono>
+#include <unordered_map>
+#include <vector>
 
 typedef int SOCKET;
 constexpr const int SOCKET_ERROR = -1;
@@ -38,6 +41,13 @@ constexpr const int INVALID_SOCKET = -1;
  */
 namespace ClientServerChannelSpace {
 
+class ChannelBenchmark;
+class ChannelStatistics;
+class FrameCompression;
+class FrameTraceReader;
+class FrameTraceWriter;
+class ShmChannel;
+
 enum CMD {
   CMD_UNDEF = -1,
   //--> Federation management
@@ -46,16 +56,34 @@ enum CMD {
   //--> Update messages
   CMD_UPDATE_NODE = 10,
   CMD_REMOVE_NODE = 11,
+  CMD_UPDATE_NODE_PACKED = 12,
+  CMD_MOBILITY_INTEREST = 13,
   //--> Advance Time
   CMD_ADVANCE_TIME = 20,
   CMD_NEXT_EVENT = 21,
   CMD_MSG_RECV = 22,
+  CMD_MSG_RECV_BATCH = 23,
   //--> Communication
   CMD_MSG_SEND = 30,
   CMD_CONF_RADIO = 31,
   //--> General
   CMD_END = 40,
-  CMD_SUCCESS = 41
+  CMD_SUCCESS = 41,
+  CMD_ERROR = 42,
+  //--> Batched commands
+  CMD_COMMAND_BATCH = 50
+};
+
+/** Protocol extensions negotiated at CMD_INIT, combined as a bit mask */
+enum CAPABILITY {
+  CAP_RECEIVE_BATCH = 1,   /* receptions are reported with CMD_MSG_RECV_BATCH */
+  CAP_COMMAND_BATCH = 2,   /* CMD_COMMAND_BATCH is accepted */
+  CAP_PIPELINED = 4,       /* commands are not acknowledged, see CMD_ERROR */
+  CAP_PACKED_UPDATE = 8,   /* CMD_UPDATE_NODE_PACKED is accepted */
+  CAP_DELTA_UPDATE = 16,   /* MOVE updates may omit nodes that barely moved */
+  CAP_INTEREST = 32,       /* CMD_MOBILITY_INTEREST is reported */
+  CAP_COMPRESSION = 64,    /* frames carry a flag byte, large ones LZ4 data */
+  CAP_FLAT_MESSAGES = 128  /* fixed layout messages, see FlatMessages.h */
 };
 
 enum RADIO_NUMBER { NO_RADIO = 0, SINGLE_RADIO = 1, DUAL_RADIO = 2 };
@@ -86,6 +114,7 @@ enum RADIO_CHANNEL {
 struct CSC_init_return {
   int64_t start_time;
   int64_t end_time;
+  uint32_t capabilities;
 };
 
 struct CSC_node_data {
@@ -134,6 +163,8 @@ struct CSC_send_message {
 };
 
 class ClientServerChannel {
+  /** Reads from a preloaded receive buffer, see benchmark/ */
+  friend class ChannelBenchmark;
 
 public:
   /** Constructor. */
@@ -145,9 +176,38 @@ public:
   /** Prepares connection with a socket bound to the given port on host. */
   virtual int prepareConnection(std::string host, uint32_t port);
 
+  /** Prepares connection with a Unix domain socket at "<path>-<port>". */
+  virtual int prepareUnixConnection(std::string path, uint32_t port);
+
+  /** Prepares connection via a shared memory segment "<name>-<port>". */
+  virtual int prepareShmConnection(std::string name, uint32_t port);
+
+  /**
+   * Reads the frames of the Ambassador from a trace of enableRecording
+   * instead of a connection, output is discarded. An empty path only discards
+   * the output. speed scales the recorded pace, 0 replays at maximum speed.
+   */
+  virtual bool prepareReplayConnection(std::string trace_path, double speed);
+
   /** Accepts connection to socket */
   virtual void connect();
 
+  /**
+   * Socket options, to be set before the prepare methods. The buffer sizes
+   * are applied to the listening socket, so the accepted socket inherits
+   * them and TCP negotiates the window scale for them. no_delay is applied
+   * by connect() and only used for TCP, buffer sizes of 0 keep the system
+   * defaults.
+   */
+  virtual void setSocketOptions(bool no_delay, int receive_buffer,
+                                int send_buffer);
+
+  /**
+   * Polls for this duration without blocking before a read blocks, trading a
+   * busy CPU for a lower latency of the answers of the Ambassador.
+   */
+  virtual void setBusyPoll(std::chrono::nanoseconds duration);
+
   /*################## READING ####################*/
 
   /** reads a command via protobuf and returns it */
@@ -156,7 +216,11 @@ public:
   /** reads an initialization message and returns it */
   virtual int readInit(CSC_init_return &return_value);
 
-  /** reads a add RSU message and returns it */
+  /**
+   * reads an update node message into return_value, reusing its memory. The
+   * encoding follows the last command, CMD_UPDATE_NODE or
+   * CMD_UPDATE_NODE_PACKED.
+   */
   virtual int readUpdateNode(CSC_update_node_return &return_value);
 
   /** Reads a configuration message from the channel and returns it */
@@ -170,13 +234,26 @@ public:
    * long */
   virtual int64_t readTimeMessage();
 
+  /** Reads a command batch, its entries are returned by readBatchCommand */
+  virtual int readCommandBatch();
+
+  /**
+   * Returns the command of the next entry of the current batch, CMD_UNDEF at
+   * its end. The entry is then read with the usual read method of the command.
+   */
+  virtual CMD readBatchCommand();
+
   /*################## WRITING ####################*/
 
   /** Byte protocol control method for writeCommand. */
   virtual void writeCommand(CMD cmd);
 
-  /** Write a message containing a port number to the output */
-  virtual void writePort(uint32_t port);
+  /**
+   * Write a message containing a port number, the offered capabilities and
+   * the distance below which moves are not applied
+   */
+  virtual void writePort(uint32_t port, uint32_t capabilities = 0,
+                         double move_epsilon = 0);
 
   /** Request a time advance from the RTI */
   virtual void writeTimeMessage(int64_t time);
@@ -185,6 +262,51 @@ public:
   virtual void writeReceiveMessage(uint64_t time, int node_id, int message_id,
                                    RADIO_CHANNEL channel, int rssi);
 
+  /** Adds a received Message to the batch sent by writeReceiveMessageBatch */
+  virtual void addReceiveMessage(uint64_t time, int node_id, int message_id,
+                                 RADIO_CHANNEL channel, int rssi);
+
+  /** Writes all added received Messages as one CMD_MSG_RECV_BATCH, if any */
+  virtual void writeReceiveMessageBatch();
+
+  /** Reports nodes whose position updates are needed again or not anymore */
+  virtual void writeMobilityInterest(const std::vector<int> &subscribe,
+                                     const std::vector<int> &unsubscribe);
+
+  /** Reports a failed command of a pipelined time advance */
+  virtual void writeCommandError(CMD cmd, int64_t time,
+                                 const std::string &description);
+
+  /** Flags all following frames and compresses messages from threshold bytes */
+  virtual void enableCompression(size_t threshold);
+
+  /** Compression counters, null if compression is not enabled */
+  virtual const FrameCompression *getCompression() const;
+
+  /** Counts messages, bytes and durations per command from now on */
+  virtual void enableStatistics();
+
+  /** Counters per command, null if statistics are not enabled */
+  virtual const ChannelStatistics *getStatistics() const;
+
+  /** Writes all frames read from now on to a trace file, see FrameTrace.h */
+  virtual bool enableRecording(std::string trace_path);
+
+  /**
+   * Switches UPDATE_NODE, MSG_SEND and MSG_RECV messages outside of batches
+   * to the fixed layout of FlatMessages.h
+   */
+  virtual void setFlatMessages(bool flat);
+
+  /** Enables or disables the CMD_SUCCESS written by the read methods */
+  virtual void setAcknowledgeCommands(bool acknowledge);
+
+  /** Sends all buffered messages to the Ambassador */
+  virtual void flush();
+
+  /** Makes a blocked or later read fail, may be called from another thread */
+  virtual void shutdownReceive();
+
 private:
   /** Initial server sock, which accepts connection of Ambassador. */
   SOCKET servsock;
@@ -195,14 +317,142 @@ private:
   /** Socket name **/
   std::string channel_name;
 
+  /** Path of the Unix domain socket, empty when connected via TCP. */
+  std::string unix_path;
+
+  /** Lock of unix_path, held while the socket exists. */
+  int unix_lock = -1;
+
+  /** Shared memory rings used instead of sock, if selected. */
+  ShmChannel *shm = nullptr;
+
+  /** Whether frames are replayed instead of received, see replay. */
+  bool replaying = false;
+
+  /** Trace the frames are replayed from, null for a write-only replay. */
+  FrameTraceReader *replay = nullptr;
+
+  /** Trace of the received frames, if recording. */
+  FrameTraceWriter *recording = nullptr;
+
+  /** Options of the sockets, see setSocketOptions. */
+  bool tcp_no_delay = true;
+  int socket_receive_buffer = 0;
+  int socket_send_buffer = 0;
+
+  /** Duration of non-blocking reads before a read blocks. */
+  std::chrono::nanoseconds busy_poll{0};
+
+  /** Set by shutdownReceive, the failing reads are expected then. */
+  std::atomic<bool> receive_shutdown{false};
+
+  /** Frame flags and compression, if negotiated. */
+  FrameCompression *compression = nullptr;
+
+  /** Counters per command, if enabled. */
+  ChannelStatistics *statistics = nullptr;
+
+  /** Time blocked in receive calls since readCommand started. */
+  uint64_t receive_blocked_ns = 0;
+
+  /** Command whose messages are currently written, for the statistics. */
+  CMD written_command = CMD_UNDEF;
+
+  /** Initial capacity of the receive buffer in bytes. */
+  static constexpr size_t RECV_BUFFER_SIZE = 64 * 1024;
+
+  /** Bytes received from the socket but not yet consumed. */
+  std::vector<char> recv_buffer;
+
+  /** Read position within the receive buffer. */
+  size_t recv_begin;
+
+  /** End of valid data within the receive buffer. */
+  size_t recv_end;
+
+  /** Messages written but not yet sent to the socket. */
+  std::vector<char> send_buffer;
+
+  /**
+   * Protobuf messages reused for every read. Parsing clears a message but keeps
+   * its allocated memory, so decoding does not allocate in the steady state.
+   */
+  CommandMessage received_command;
+  InitMessage received_init;
+  UpdateNode received_update_node;
+  TimeMessage received_time;
+  ConfigureRadioMessage received_config;
+  SendMessageMessage received_send_message;
+  CommandBatch received_command_batch;
+
+  /** Last command returned by readCommand or readBatchCommand. */
+  CMD last_command = CMD_UNDEF;
+
+  /** Whether the most frequent messages use the fixed layout. */
+  bool flat_messages = false;
+
+  /** Whether read methods acknowledge their command with CMD_SUCCESS. */
+  bool acknowledge_commands = true;
+
+  /** Index of the batch entry read next by readBatchCommand. */
+  int batch_index = 0;
+
+  /** Batch entry read instead of a frame by the read methods, if not null. */
+  const CommandBatch_Entry *batch_entry = nullptr;
+
+  /** Receptions added since the last writeReceiveMessageBatch. */
+  ReceiveMessageBatch receive_batch;
+
+  /** Index of the receptions group in receive_batch per message and channel. */
+  std::unordered_map<uint64_t, int> receive_batch_groups;
+
   /** Converts commands to protobuf-internal commands */
   virtual CommandMessage_CommandType cmdToProtoCMD(CMD cmd);
 
   /** Converts protobuf commands to CMD enum */
   virtual CMD protoCMDToCMD(CommandMessage_CommandType cmd);
 
-  /** Reads a Varint from a socket and returns it */
-  virtual std::shared_ptr<uint32_t> readVarintPrefix(SOCKET sock);
+  /** Receives from the socket until num_bytes are buffered */
+  virtual bool fillReceiveBuffer(size_t num_bytes);
+
+  /** One recv call on the socket, polling first if busy_poll is set */
+  virtual ssize_t receiveFromSocket(char *buffer, size_t max_bytes);
+
+  /** Sets an option of a socket, logs if it fails */
+  void applySocketOption(int fd, int level, int option, int value,
+                         const char *name);
+
+  /** Sets the buffer sizes on the listening socket before listen() */
+  void applySocketBuffers();
+
+  /** Reads a Varint from the receive buffer */
+  virtual bool readVarintPrefix(uint32_t &return_value);
+
+  /** Reads a length prefixed message and points frame into the buffer */
+  virtual bool readFrame(const char *&frame, uint32_t &frame_size);
+
+  /** Reads the next frame of the replayed trace instead */
+  virtual bool readReplayFrame(const char *&frame, uint32_t &frame_size);
+
+  /** Counts the bytes appended to send_buffer from begin on */
+  void countWritten(size_t begin);
+
+  /** Decodes an UpdateNodePacked message directly from the wire format */
+  virtual int decodeUpdateNodePacked(const char *buffer, uint32_t size,
+                                     CSC_update_node_return &return_value);
+
+  /** Converts a parsed UpdateNodePacked message, e.g. of a command batch */
+  virtual int convertUpdateNodePacked(const UpdateNodePacked &update_message,
+                                      CSC_update_node_return &return_value);
+
+  /** Appends a length prefixed message to the output buffer */
+  virtual void writeMessage(const google::protobuf::MessageLite &message);
+
+  /** Appends a length prefixed frame of raw bytes to the output buffer */
+  virtual void writeFrame(const char *data, size_t size);
+
+  /** converts a protobuf update type to our update type, 0 if unknown */
+  virtual UPDATE_NODE_TYPE protoUpdateTypeToUpdateType(int protoType);
 
   /** converts a channel given as a protobuf internal enum to our channel enum
    */
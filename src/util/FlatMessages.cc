@@ -0,0 +1,143 @@
+/*
+ * Copyright (c) 2020 Fraunhofer FOKUS and others. All rights reserved.
+ *
+ * Contact: mosaic@fokus.fraunhofer.de
+ *
+ * This class is developed for the MOSAIC-OMNeT++ coupling.
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License version 2 as
+ * published by the Free Software Foundation;
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+ *
+ */
+
+#include "FlatMessages.h"
+
+#include <climits>
+#include <cstring>
+
+namespace ClientServerChannelSpace {
+namespace flat {
+
+namespace {
+
+template <typename T> T load(const char *buffer, size_t offset) {
+  T value;
+  std::memcpy(&value, buffer + offset, sizeof(T));
+  return value;
+}
+
+template <typename T> void store(char *buffer, size_t offset, T value) {
+  std::memcpy(buffer + offset, &value, sizeof(T));
+}
+
+} // namespace
+
+int decodeUpdateNode(const char *buffer, size_t size,
+                     CSC_update_node_return &return_value) {
+  if (size < UPDATE_NODE_HEADER_SIZE) {
+    return 1;
+  }
+  const uint32_t type = load<uint32_t>(buffer, 8);
+  const uint32_t num_nodes = load<uint32_t>(buffer, 12);
+  if (type < UPDATE_ADD_RSU || type > UPDATE_REMOVE_NODE ||
+      size < UPDATE_NODE_HEADER_SIZE +
+                 static_cast<size_t>(num_nodes) * UPDATE_NODE_ENTRY_SIZE) {
+    return 1;
+  }
+  // UpdateNode.UpdateType has the values of UPDATE_NODE_TYPE
+  return_value.type = static_cast<UPDATE_NODE_TYPE>(type);
+  return_value.time = load<int64_t>(buffer, 0);
+  return_value.properties.resize(num_nodes);
+  const char *entry = buffer + UPDATE_NODE_HEADER_SIZE;
+  for (CSC_node_data &node : return_value.properties) {
+    node.id = load<int32_t>(entry, 0);
+    node.x = load<double>(entry, 8);
+    node.y = load<double>(entry, 16);
+    entry += UPDATE_NODE_ENTRY_SIZE;
+  }
+  return 0;
+}
+
+void encodeUpdateNode(const CSC_update_node_return &update,
+                      std::vector<char> &out) {
+  const size_t offset = out.size();
+  out.resize(offset + UPDATE_NODE_HEADER_SIZE +
+             update.properties.size() * UPDATE_NODE_ENTRY_SIZE);
+  char *target = out.data() + offset;
+  store<int64_t>(target, 0, update.time);
+  store<uint32_t>(target, 8, update.type);
+  store<uint32_t>(target, 12, update.properties.size());
+  target += UPDATE_NODE_HEADER_SIZE;
+  for (const CSC_node_data &node : update.properties) {
+    store<int32_t>(target, 0, node.id);
+    store<uint32_t>(target, 4, 0);
+    store<double>(target, 8, node.x);
+    store<double>(target, 16, node.y);
+    target += UPDATE_NODE_ENTRY_SIZE;
+  }
+}
+
+int decodeSendMessage(const char *buffer, size_t size,
+                      CSC_send_message &return_value) {
+  if (size < SEND_MESSAGE_SIZE) {
+    return 1;
+  }
+  const uint32_t node_id = load<uint32_t>(buffer, 16);
+  const uint32_t channel = load<uint32_t>(buffer, 20);
+  const uint32_t message_id = load<uint32_t>(buffer, 24);
+  const uint32_t address_type = load<uint32_t>(buffer, 28);
+  // ids are int in the federate
+  if (node_id > INT_MAX || message_id > INT_MAX || channel > UNDEF_CHANNEL ||
+      address_type < FLAT_ADDRESS_TOPO || address_type > FLAT_ADDRESS_CIRCLE) {
+    return 1;
+  }
+  return_value.time = load<int64_t>(buffer, 0);
+  return_value.length = load<uint64_t>(buffer, 8);
+  return_value.node_id = node_id;
+  // RadioChannel has the values of RADIO_CHANNEL
+  return_value.channel_id = static_cast<RADIO_CHANNEL>(channel);
+  return_value.message_id = message_id;
+  return_value.topo_address.ip_address = load<uint32_t>(buffer, 32);
+  // geographic addresses are not supported yet, as with protobuf messages
+  return_value.topo_address.ttl = address_type == FLAT_ADDRESS_TOPO
+                                      ? load<uint32_t>(buffer, 36)
+                                      : 10;
+  return 0;
+}
+
+void encodeSendMessage(const CSC_send_message &message,
+                       std::vector<char> &out) {
+  const size_t offset = out.size();
+  out.resize(offset + SEND_MESSAGE_SIZE);
+  char *target = out.data() + offset;
+  store<int64_t>(target, 0, message.time);
+  store<uint64_t>(target, 8, message.length);
+  store<uint32_t>(target, 16, message.node_id);
+  store<uint32_t>(target, 20, message.channel_id);
+  store<uint32_t>(target, 24, message.message_id);
+  store<uint32_t>(target, 28, FLAT_ADDRESS_TOPO);
+  store<uint32_t>(target, 32, message.topo_address.ip_address);
+  store<uint32_t>(target, 36, message.topo_address.ttl);
+}
+
+void encodeReceiveMessage(int64_t time, int node_id, int message_id,
+                          RADIO_CHANNEL channel, float rssi, char *out) {
+  store<int64_t>(out, 0, time);
+  store<uint32_t>(out, 8, node_id);
+  store<uint32_t>(out, 12, channel);
+  store<uint32_t>(out, 16, message_id);
+  store<float>(out, 20, rssi);
+}
+
+} // namespace flat
+} // namespace ClientServerChannelSpace
@@ -0,0 +1,95 @@
+/*
+ * Copyright (c) 2020 Fraunhofer FOKUS and others. All rights reserved.
+ *
+ * Contact: mosaic@fokus.fraunhofer.de
+ *
+ * This class is developed for the MOSAIC-OMNeT++ coupling.
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License version 2 as
+ * published by the Free Software Foundation;
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+ *
+ */
+
+#ifndef __FLATMESSAGES_H__
+#define __FLATMESSAGES_H__
+
+#include "ClientServerChannel.h"
+
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+static_assert(__BYTE_ORDER__ == __ORDER_LITTLE_ENDIAN__,
+              "flat messages are read in place on little-endian hosts");
+
+/**
+ * Fixed layout encoding of the most frequent messages, used instead of
+ * protobuf once CAP_FLAT_MESSAGES is negotiated. Fields are little-endian
+ * without padding between them, offsets are given in bytes.
+ *
+ * UpdateNode (CMD_UPDATE_NODE), 16 byte header and 24 bytes per node:
+ *   0 int64 time, 8 uint32 update_type (UpdateNode.UpdateType),
+ *   12 uint32 num_nodes, then per node
+ *   0 int32 id, 4 uint32 reserved (0), 8 double x, 16 double y
+ *
+ * SendMessageMessage (CMD_MSG_SEND), 40 bytes:
+ *   0 int64 time, 8 uint64 length, 16 uint32 node_id,
+ *   20 uint32 channel_id (RadioChannel), 24 uint32 message_id,
+ *   28 uint32 address_type (FLAT_ADDRESS_*), 32 uint32 ip_address,
+ *   36 uint32 ttl (only used for FLAT_ADDRESS_TOPO)
+ *
+ * ReceiveMessage (CMD_MSG_RECV), 24 bytes:
+ *   0 int64 time, 8 uint32 node_id, 12 uint32 channel_id (RadioChannel),
+ *   16 uint32 message_id, 20 float rssi
+ *
+ * The functions have no OMNeT++ dependencies so that peers and benchmarks can
+ * use them.
+ */
+namespace ClientServerChannelSpace {
+namespace flat {
+
+constexpr size_t UPDATE_NODE_HEADER_SIZE = 16;
+constexpr size_t UPDATE_NODE_ENTRY_SIZE = 24;
+constexpr size_t SEND_MESSAGE_SIZE = 40;
+constexpr size_t RECEIVE_MESSAGE_SIZE = 24;
+
+enum FLAT_ADDRESS_TYPE {
+  FLAT_ADDRESS_TOPO = 1,
+  FLAT_ADDRESS_RECTANGLE = 2,
+  FLAT_ADDRESS_CIRCLE = 3
+};
+
+/** Decodes an update in place into return_value, keeping its capacity.
+ *  @return 0 if successful */
+int decodeUpdateNode(const char *buffer, size_t size,
+                     CSC_update_node_return &return_value);
+
+/** Appends the flat encoding of an update to out. */
+void encodeUpdateNode(const CSC_update_node_return &update,
+                      std::vector<char> &out);
+
+/** Decodes a send message command. @return 0 if successful */
+int decodeSendMessage(const char *buffer, size_t size,
+                      CSC_send_message &return_value);
+
+/** Appends the flat encoding of a topologically addressed send message. */
+void encodeSendMessage(const CSC_send_message &message,
+                       std::vector<char> &out);
+
+/** Writes a reception to out, which holds RECEIVE_MESSAGE_SIZE bytes. */
+void encodeReceiveMessage(int64_t time, int node_id, int message_id,
+                          RADIO_CHANNEL channel, float rssi, char *out);
+
+} // namespace flat
+} // namespace ClientServerChannelSpace
+#endif
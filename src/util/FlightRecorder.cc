@@ -0,0 +1,129 @@
+/*
+ * Copyright (c) 2020 Fraunhofer FOKUS and others. All rights reserved.
+ *
+ * Contact: mosaic@fokus.fraunhofer.de
+ *
+ * This class is developed for the MOSAIC-OMNeT++ coupling.
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License version 2 as
+ * published by the Free Software Foundation;
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+ *
+ */
+
+#include "FlightRecorder.h"
+
+#include <cerrno>
+#include <csignal>
+#include <cstring>
+#include <ctime>
+#include <fcntl.h>
+#include <unistd.h>
+
+namespace ClientServerChannelSpace {
+
+namespace {
+
+constexpr char DUMP_MAGIC[8] = {'M', 'O', 'S', 'F', 'L', 'R', 'E', 'C'};
+
+int64_t clockNs(clockid_t clock) {
+  timespec now;
+  clock_gettime(clock, &now);
+  return static_cast<int64_t>(now.tv_sec) * 1000000000 + now.tv_nsec;
+}
+
+/** Writes all bytes, retrying short writes, async-signal-safe. */
+bool writeAll(int fd, const void *data, size_t size) {
+  const char *bytes = static_cast<const char *>(data);
+  while (size > 0) {
+    const ssize_t count = write(fd, bytes, size);
+    if (count < 0) {
+      if (errno == EINTR) {
+        continue;
+      }
+      return false;
+    }
+    bytes += count;
+    size -= count;
+  }
+  return true;
+}
+
+} // namespace
+
+void FlightRecorder::configure(size_t capacity,
+                               const std::string &file_path) {
+  size_t rounded = 1;
+  while (rounded < capacity) {
+    rounded *= 2;
+  }
+  if (ring == nullptr || capacity == 0 || mask + 1 != rounded) {
+    delete[] ring;
+    ring = capacity > 0 ? new FlightRecord[rounded]() : nullptr;
+    mask = rounded - 1;
+  }
+  next.store(0, std::memory_order_relaxed);
+  sim_time.store(0, std::memory_order_relaxed);
+  path = file_path;
+  signal_path = file_path + ".signal";
+  start_ticks = ticks();
+  start_ns = clockNs(CLOCK_MONOTONIC);
+  start_wall_ns = clockNs(CLOCK_REALTIME);
+}
+
+bool FlightRecorder::dump(const char *file_path) {
+  if (ring == nullptr) {
+    return false;
+  }
+  const int fd = open(file_path, O_WRONLY | O_CREAT | O_TRUNC, 0644);
+  if (fd < 0) {
+    return false;
+  }
+  char header[HEADER_SIZE];
+  const uint32_t record_size = sizeof(FlightRecord);
+  const uint64_t capacity = mask + 1;
+  const uint64_t taken = next.load(std::memory_order_relaxed);
+  const uint64_t dump_ticks = ticks();
+  const int64_t dump_ns = clockNs(CLOCK_MONOTONIC);
+  std::memcpy(header, DUMP_MAGIC, sizeof(DUMP_MAGIC));
+  std::memcpy(header + 8, &VERSION, 4);
+  std::memcpy(header + 12, &record_size, 4);
+  std::memcpy(header + 16, &capacity, 8);
+  std::memcpy(header + 24, &taken, 8);
+  std::memcpy(header + 32, &start_ticks, 8);
+  std::memcpy(header + 40, &start_ns, 8);
+  std::memcpy(header + 48, &dump_ticks, 8);
+  std::memcpy(header + 56, &dump_ns, 8);
+  std::memcpy(header + 64, &start_wall_ns, 8);
+  const bool written = writeAll(fd, header, sizeof(header)) &&
+                       writeAll(fd, ring, capacity * sizeof(FlightRecord));
+  close(fd);
+  return written;
+}
+
+bool FlightRecorder::dumpOnSignal(int signal) {
+  struct sigaction action;
+  std::memset(&action, 0, sizeof(action));
+  action.sa_handler = &FlightRecorder::handleSignal;
+  sigemptyset(&action.sa_mask);
+  // blocking reads of the channels continue after the dump
+  action.sa_flags = SA_RESTART;
+  return sigaction(signal, &action, nullptr) == 0;
+}
+
+void FlightRecorder::handleSignal(int) {
+  const int saved_errno = errno;
+  dump(signal_path.c_str());
+  errno = saved_errno;
+}
+
+} // namespace ClientServerChannelSpace
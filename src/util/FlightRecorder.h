@@ -0,0 +1,179 @@
+/*
+ * Copyright (c) 2020 Fraunhofer FOKUS and others. All rights reserved.
+ *
+ * Contact: mosaic@fokus.fraunhofer.de
+ *
+ * This class is developed for the MOSAIC-OMNeT++ coupling.
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License version 2 as
+ * published by the Free Software Foundation;
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+ *
+ */
+
+#ifndef __FLIGHTRECORDER_H__
+#define __FLIGHTRECORDER_H__
+
+#include <atomic>
+#include <chrono>
+#include <cstddef>
+#include <cstdint>
+#include <string>
+
+#if defined(__x86_64__) || defined(__i386__)
+#include <x86intrin.h>
+#endif
+
+static_assert(__BYTE_ORDER__ == __ORDER_LITTLE_ENDIAN__,
+              "flight recorder dumps are written in host order");
+
+namespace ClientServerChannelSpace {
+
+/**
+ * Events kept by the flight recorder, the meaning of command, size and value
+ * depends on the event.
+ */
+enum FLIGHT_EVENT {
+  /** command frame received, value ns blocked in receive before it if the
+   * channel keeps statistics */
+  FLIGHT_COMMAND_IN = 1,
+  /** message frame of the command received last, size in bytes */
+  FLIGHT_FRAME_IN = 2,
+  /** frame of the command written last, size in bytes with the prefix */
+  FLIGHT_FRAME_OUT = 3,
+  /** size buffered bytes are about to be sent */
+  FLIGHT_FLUSH = 4,
+  /** a read needs size more bytes than buffered */
+  FLIGHT_RECEIVE = 5,
+  /** time advance granted up to value ns */
+  FLIGHT_ADVANCE_TIME = 6,
+  /** next event at value ns reported */
+  FLIGHT_NEXT_EVENT = 7,
+  /** time advance ended at value ns */
+  FLIGHT_END_ADVANCE = 8,
+  /** command could not be executed */
+  FLIGHT_COMMAND_ERROR = 9,
+  /** coupling failed, command is the unexpected one */
+  FLIGHT_FAILURE = 10
+};
+
+/**
+ * One entry of the ring, 32 bytes.
+ */
+struct FlightRecord {
+  /** time stamp counter, or ns of the monotonic clock on other machines */
+  uint64_t ticks;
+  /** simulation time in ns when the record was taken */
+  int64_t sim_time;
+  int64_t value;
+  uint32_t size;
+  uint16_t event;
+  int16_t command;
+};
+static_assert(sizeof(FlightRecord) == 32, "records are dumped as they are");
+
+/**
+ * Always-on recorder of the last frames of the channels and state changes of
+ * the scheduler, to analyse a coupling that stalls or slows down after hours.
+ * record() fills the next slot of a fixed ring in memory, dump() writes the
+ * ring to a file. dump() only uses async-signal-safe calls, so it may run in
+ * a signal handler while the simulation thread is blocked.
+ *
+ * Dump, little-endian, header 72 bytes:
+ *   0 char[8] magic "MOSFLREC", 8 uint32 version (1), 12 uint32 record size,
+ *   16 uint64 capacity, 24 uint64 records taken since configure(),
+ *   32 uint64 ticks and 40 int64 ns of the monotonic clock at configure(),
+ *   48 uint64 ticks and 56 int64 ns of the monotonic clock at the dump,
+ *   64 int64 wall-clock time of configure() in ns since the epoch
+ * followed by the ring of capacity records, the oldest at index "records
+ * taken" modulo capacity once the ring wrapped. Ticks are converted to time
+ * with the two clock samples.
+ *
+ * Records are taken from several threads without locks, a record written
+ * during a dump may be torn. The class has no OMNeT++ dependencies so that
+ * tools can use it.
+ */
+class FlightRecorder {
+
+public:
+  static constexpr uint32_t VERSION = 1;
+  static constexpr size_t HEADER_SIZE = 72;
+
+  /**
+   * Allocates a ring of at least capacity records, rounded up to a power of
+   * two, and resets it. 0 disables recording. Must not run concurrently with
+   * record().
+   * @param file_path file written by dump()
+   */
+  static void configure(size_t capacity, const std::string &file_path);
+
+  /** Takes a record, a few ns without locks. */
+  static void record(FLIGHT_EVENT event, int command, uint32_t size,
+                     int64_t value) {
+    FlightRecord *const records = ring;
+    if (records == nullptr) {
+      return;
+    }
+    FlightRecord &entry =
+        records[next.fetch_add(1, std::memory_order_relaxed) & mask];
+    entry.ticks = ticks();
+    entry.sim_time = sim_time.load(std::memory_order_relaxed);
+    entry.value = value;
+    entry.size = size;
+    entry.event = event;
+    entry.command = static_cast<int16_t>(command);
+  }
+
+  /** Simulation time in ns stamped on the following records. */
+  static void setSimTime(int64_t time) {
+    sim_time.store(time, std::memory_order_relaxed);
+  }
+
+  /** Writes the ring to the configured file, async-signal-safe. */
+  static bool dump() { return dump(path.c_str()); }
+
+  /** Writes the ring to a file, async-signal-safe. */
+  static bool dump(const char *file_path);
+
+  /** Dumps the ring to "<path>.signal" whenever the signal arrives. */
+  static bool dumpOnSignal(int signal);
+
+  static bool enabled() { return ring != nullptr; }
+  static const std::string &getPath() { return path; }
+
+  static uint64_t ticks() {
+#if defined(__x86_64__) || defined(__i386__)
+    return __rdtsc();
+#else
+    return std::chrono::duration_cast<std::chrono::nanoseconds>(
+               std::chrono::steady_clock::now().time_since_epoch())
+        .count();
+#endif
+  }
+
+private:
+  static void handleSignal(int signal);
+
+  inline static FlightRecord *ring = nullptr;
+  inline static uint64_t mask = 0;
+  inline static std::atomic<uint64_t> next{0};
+  inline static std::atomic<int64_t> sim_time{0};
+  inline static std::string path;
+  inline static std::string signal_path;
+  /** clock samples of configure() */
+  inline static uint64_t start_ticks = 0;
+  inline static int64_t start_ns = 0;
+  inline static int64_t start_wall_ns = 0;
+};
+
+} // namespace ClientServerChannelSpace
+#endif
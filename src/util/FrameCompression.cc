@@ -0,0 +1,185 @@
+/*
+ * Copyright (c) 2020 Fraunhofer FOKUS and others. All rights reserved.
+ *
+ * Contact: mosaic@fokus.fraunhofer.de
+ *
+ * This class is developed for the MOSAIC-OMNeT++ coupling.
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License version 2 as
+ * published by the Free Software Foundation;
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+ *
+ */
+
+#include "FrameCompression.h"
+
+#include <chrono>
+#include <cstring>
+#include <google/protobuf/io/coded_stream.h>
+
+#ifdef WITH_LZ4
+#include <lz4.h>
+#endif
+
+namespace ClientServerChannelSpace {
+
+using google::protobuf::io::CodedOutputStream;
+
+namespace {
+
+#ifdef WITH_LZ4
+/**
+ * LZ4 cannot expand data by more than this factor, a frame announcing a
+ * larger message is corrupt and must not cause its allocation.
+ */
+constexpr uint64_t MAX_LZ4_RATIO = 255;
+
+double secondsSince(std::chrono::steady_clock::time_point start) {
+  return std::chrono::duration<double>(std::chrono::steady_clock::now() - start)
+      .count();
+}
+#endif
+
+/** Appends the prefix of a frame with a body of body_size bytes. */
+uint8_t *appendPrefix(std::vector<char> &buffer, size_t body_size,
+                      size_t reserve) {
+  const uint32_t frame_size = 1 + body_size;
+  const size_t offset = buffer.size();
+  buffer.resize(offset + CodedOutputStream::VarintSize32(frame_size) + 1 +
+                reserve);
+  uint8_t *target = reinterpret_cast<uint8_t *>(buffer.data() + offset);
+  return CodedOutputStream::WriteVarint32ToArray(frame_size, target);
+}
+
+} // namespace
+
+bool FrameCompression::available() {
+#ifdef WITH_LZ4
+  return true;
+#else
+  return false;
+#endif
+}
+
+void FrameCompression::writeFrame(const google::protobuf::MessageLite &message,
+                                  std::vector<char> &buffer) {
+  const size_t message_size = message.ByteSizeLong();
+#ifdef WITH_LZ4
+  if (message_size >= threshold) {
+    uncompressed.resize(message_size);
+    message.SerializeWithCachedSizesToArray(
+        reinterpret_cast<uint8_t *>(uncompressed.data()));
+    writeFrame(uncompressed.data(), message_size, buffer);
+    return;
+  }
+#endif
+  statistics.frames_written++;
+  uint8_t *target = appendPrefix(buffer, message_size, message_size);
+  *target++ = FRAME_RAW;
+  message.SerializeWithCachedSizesToArray(target);
+}
+
+void FrameCompression::writeFrame(const char *data, size_t size,
+                                  std::vector<char> &buffer) {
+  statistics.frames_written++;
+#ifdef WITH_LZ4
+  if (size >= threshold && appendCompressed(data, size, buffer)) {
+    return;
+  }
+#endif
+  uint8_t *target = appendPrefix(buffer, size, size);
+  *target++ = FRAME_RAW;
+  std::memcpy(target, data, size);
+}
+
+#ifdef WITH_LZ4
+/**
+ * Appends data as FRAME_LZ4 frame.
+ * @return false if compression does not make the frame smaller
+ */
+bool FrameCompression::appendCompressed(const char *data, size_t size,
+                                        std::vector<char> &buffer) {
+  const auto start = std::chrono::steady_clock::now();
+  const size_t size_length = CodedOutputStream::VarintSize32(size);
+  const int bound = LZ4_compressBound(size);
+  // the prefix is written with the final size once it is known
+  const size_t offset = buffer.size();
+  buffer.resize(offset + 5 + 1 + size_length + bound);
+  char *body = buffer.data() + offset + 5 + 1;
+  CodedOutputStream::WriteVarint32ToArray(size,
+                                          reinterpret_cast<uint8_t *>(body));
+  const int compressed_size =
+      LZ4_compress_default(data, body + size_length, size, bound);
+  const size_t body_size = size_length + compressed_size;
+  statistics.compress_seconds += secondsSince(start);
+  if (compressed_size <= 0 || body_size >= size) {
+    buffer.resize(offset);
+    return false;
+  }
+  uint8_t *target = reinterpret_cast<uint8_t *>(buffer.data() + offset);
+  target = CodedOutputStream::WriteVarint32ToArray(1 + body_size, target);
+  *target++ = FRAME_LZ4;
+  std::memmove(target, body, body_size);
+  buffer.resize(reinterpret_cast<char *>(target) - buffer.data() + body_size);
+  statistics.frames_compressed++;
+  statistics.compress_bytes_in += size;
+  statistics.compress_bytes_out += body_size;
+  return true;
+}
+#endif
+
+bool FrameCompression::readFrame(const char *&frame, uint32_t &frame_size) {
+  if (frame_size < 1) {
+    return false;
+  }
+  const uint8_t flag = frame[0];
+  frame++;
+  frame_size--;
+  statistics.frames_read++;
+  if (flag == FRAME_RAW) {
+    return true;
+  }
+#ifdef WITH_LZ4
+  if (flag == FRAME_LZ4) {
+    const auto start = std::chrono::steady_clock::now();
+    google::protobuf::io::CodedInputStream input(
+        reinterpret_cast<const uint8_t *>(frame), frame_size);
+    uint32_t message_size = 0;
+    if (!input.ReadVarint32(&message_size)) {
+      return false;
+    }
+    const int size_length = input.CurrentPosition();
+    if (message_size >
+        static_cast<uint64_t>(frame_size - size_length) * MAX_LZ4_RATIO) {
+      return false;
+    }
+    decompressed.resize(message_size);
+    const int decompressed_size =
+        LZ4_decompress_safe(frame + size_length, decompressed.data(),
+                            frame_size - size_length, message_size);
+    if (decompressed_size < 0 ||
+        static_cast<uint32_t>(decompressed_size) != message_size) {
+      return false;
+    }
+    statistics.frames_decompressed++;
+    statistics.decompress_bytes_in += frame_size;
+    statistics.decompress_bytes_out += message_size;
+    statistics.decompress_seconds += secondsSince(start);
+    frame = decompressed.data();
+    frame_size = message_size;
+    return true;
+  }
+#endif
+  return false;
+}
+
+} // namespace ClientServerChannelSpace
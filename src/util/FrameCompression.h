@@ -0,0 +1,107 @@
+/*
+ * Copyright (c) 2020 Fraunhofer FOKUS and others. All rights reserved.
+ *
+ * Contact: mosaic@fokus.fraunhofer.de
+ *
+ * This class is developed for the MOSAIC-OMNeT++ coupling.
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License version 2 as
+ * published by the Free Software Foundation;
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+ *
+ */
+
+#ifndef __FRAMECOMPRESSION_H__
+#define __FRAMECOMPRESSION_H__
+
+#include <google/protobuf/message_lite.h>
+
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+namespace ClientServerChannelSpace {
+
+/**
+ * Frame layout used once CAP_COMPRESSION is negotiated. The length prefix of a
+ * frame covers a flag byte and the body. The body of a FRAME_RAW frame is the
+ * message itself, the body of a FRAME_LZ4 frame is the size of the message as
+ * a varint followed by the message compressed as one LZ4 block.
+ *
+ * Only messages of at least the threshold size are compressed, and only if
+ * that makes them smaller, so control frames like CommandMessage stay raw.
+ * Without WITH_LZ4 all frames are written raw and compressed frames are
+ * rejected. The class has no OMNeT++ dependencies so that stand-in peers can
+ * use it.
+ */
+class FrameCompression {
+
+public:
+  enum FRAME_FLAG { FRAME_RAW = 0, FRAME_LZ4 = 1 };
+
+  /** Counters of one channel, sizes are frame bodies without prefixes. */
+  struct Statistics {
+    uint64_t frames_written = 0;
+    uint64_t frames_compressed = 0;
+    /** Size of the compressed messages before and after compression. */
+    uint64_t compress_bytes_in = 0;
+    uint64_t compress_bytes_out = 0;
+    double compress_seconds = 0;
+    uint64_t frames_read = 0;
+    uint64_t frames_decompressed = 0;
+    uint64_t decompress_bytes_in = 0;
+    uint64_t decompress_bytes_out = 0;
+    double decompress_seconds = 0;
+  };
+
+  /** Whether compressed frames can be written and read by this build. */
+  static bool available();
+
+  /** @param threshold smallest message size in bytes that is compressed */
+  explicit FrameCompression(size_t threshold) : threshold(threshold) {}
+  virtual ~FrameCompression() = default;
+
+  /** Appends message as a length prefixed, flagged frame to buffer. */
+  virtual void writeFrame(const google::protobuf::MessageLite &message,
+                          std::vector<char> &buffer);
+
+  /** Appends data that is not a protobuf message as a flagged frame. */
+  virtual void writeFrame(const char *data, size_t size,
+                          std::vector<char> &buffer);
+
+  /**
+   * Decodes a flagged frame body. On success frame and frame_size refer to the
+   * message, either inside the given body or inside an internal buffer that
+   * stays valid until the next call.
+   */
+  virtual bool readFrame(const char *&frame, uint32_t &frame_size);
+
+  const Statistics &getStatistics() const { return statistics; }
+
+private:
+  size_t threshold;
+  Statistics statistics;
+
+  /** Serialized message before compression. */
+  std::vector<char> uncompressed;
+
+  /** Message of the last decompressed frame. */
+  std::vector<char> decompressed;
+
+#ifdef WITH_LZ4
+  bool appendCompressed(const char *data, size_t size,
+                        std::vector<char> &buffer);
+#endif
+};
+
+} // namespace ClientServerChannelSpace
+#endif
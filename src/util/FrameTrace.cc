@@ -0,0 +1,185 @@
+/*
+ * Copyright (c) 2020 Fraunhofer FOKUS and others. All rights reserved.
+ *
+ * Contact: mosaic@fokus.fraunhofer.de
+ *
+ * This class is developed for the MOSAIC-OMNeT++ coupling.
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License version 2 as
+ * published by the Free Software Foundation;
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+ *
+ */
+
+#include "FrameTrace.h"
+
+#include <cerrno>
+#include <cstring>
+#include <fcntl.h>
+#include <iostream>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <thread>
+#include <unistd.h>
+
+namespace ClientServerChannelSpace {
+
+namespace {
+
+constexpr char TRACE_MAGIC[8] = {'M', 'O', 'S', 'T', 'R', 'A', 'C', 'E'};
+constexpr uint32_t TRACE_VERSION = 1;
+constexpr size_t HEADER_SIZE = 24;
+constexpr size_t RECORD_HEADER_SIZE = 12;
+/** Buffer of the trace file, a record is written with one system call. */
+constexpr size_t WRITE_BUFFER_SIZE = 1024 * 1024;
+/** Longest sleep while pacing, so that shutdown() is noticed. */
+constexpr auto MAX_SLEEP = std::chrono::milliseconds(10);
+
+} // namespace
+
+FrameTraceWriter::~FrameTraceWriter() {
+  if (file != nullptr) {
+    std::fclose(file);
+  }
+}
+
+bool FrameTraceWriter::open(const std::string &path) {
+  file = std::fopen(path.c_str(), "wb");
+  if (file == nullptr) {
+    std::cerr << "Error: FrameTraceWriter could not create " << path << " - "
+              << strerror(errno) << std::endl;
+    return false;
+  }
+  std::setvbuf(file, nullptr, _IOFBF, WRITE_BUFFER_SIZE);
+  this->path = path;
+  start = std::chrono::steady_clock::now();
+  char header[HEADER_SIZE] = {};
+  const uint32_t version = TRACE_VERSION;
+  const int64_t wall_clock =
+      std::chrono::duration_cast<std::chrono::nanoseconds>(
+          std::chrono::system_clock::now().time_since_epoch())
+          .count();
+  std::memcpy(header, TRACE_MAGIC, sizeof(TRACE_MAGIC));
+  std::memcpy(header + 8, &version, sizeof(version));
+  std::memcpy(header + 16, &wall_clock, sizeof(wall_clock));
+  if (std::fwrite(header, 1, sizeof(header), file) != sizeof(header) ||
+      std::fflush(file) != 0) {
+    fail();
+    return false;
+  }
+  return true;
+}
+
+void FrameTraceWriter::write(const char *frame, uint32_t frame_size) {
+  if (file == nullptr) {
+    return;
+  }
+  char record[RECORD_HEADER_SIZE];
+  const uint64_t offset = std::chrono::duration_cast<std::chrono::nanoseconds>(
+                              std::chrono::steady_clock::now() - start)
+                              .count();
+  std::memcpy(record, &offset, sizeof(offset));
+  std::memcpy(record + 8, &frame_size, sizeof(frame_size));
+  if (std::fwrite(record, 1, sizeof(record), file) != sizeof(record) ||
+      std::fwrite(frame, 1, frame_size, file) != frame_size ||
+      std::fflush(file) != 0) {
+    fail();
+  }
+}
+
+void FrameTraceWriter::fail() {
+  std::cerr << "Error: FrameTraceWriter could not write " << path << " - "
+            << strerror(errno) << ", the recording stops" << std::endl;
+  std::fclose(file);
+  file = nullptr;
+}
+
+FrameTraceReader::~FrameTraceReader() {
+  if (data != nullptr) {
+    munmap(const_cast<char *>(data), size);
+  }
+}
+
+bool FrameTraceReader::open(const std::string &path, double speed) {
+  this->speed = speed;
+  const int fd = ::open(path.c_str(), O_RDONLY);
+  struct stat status;
+  if (fd < 0 || fstat(fd, &status) != 0) {
+    std::cerr << "Error: FrameTraceReader could not open " << path << " - "
+              << strerror(errno) << std::endl;
+    if (fd >= 0) {
+      close(fd);
+    }
+    return false;
+  }
+  size = status.st_size;
+  void *address = size >= HEADER_SIZE
+                      ? mmap(nullptr, size, PROT_READ, MAP_PRIVATE, fd, 0)
+                      : MAP_FAILED;
+  close(fd);
+  if (address == MAP_FAILED) {
+    std::cerr << "Error: FrameTraceReader could not map " << path << std::endl;
+    return false;
+  }
+  data = static_cast<const char *>(address);
+  // frames are read once from front to back
+  madvise(address, size, MADV_SEQUENTIAL);
+  uint32_t version;
+  std::memcpy(&version, data + 8, sizeof(version));
+  if (std::memcmp(data, TRACE_MAGIC, sizeof(TRACE_MAGIC)) != 0 ||
+      version != TRACE_VERSION) {
+    std::cerr << "Error: FrameTraceReader " << path
+              << " is not a frame trace of version " << TRACE_VERSION
+              << std::endl;
+    return false;
+  }
+  position = HEADER_SIZE;
+  return true;
+}
+
+bool FrameTraceReader::next(const char *&frame, uint32_t &frame_size) {
+  if (stopped || position + RECORD_HEADER_SIZE > size) {
+    return false;
+  }
+  uint64_t offset;
+  std::memcpy(&offset, data + position, sizeof(offset));
+  std::memcpy(&frame_size, data + position + 8, sizeof(frame_size));
+  if (position + RECORD_HEADER_SIZE + frame_size > size) {
+    std::cerr << "Error: FrameTraceReader trace ends within a frame"
+              << std::endl;
+    return false;
+  }
+  if (frames_read == 0) {
+    first_offset = offset;
+    first_time = std::chrono::steady_clock::now();
+  } else if (speed > 0) {
+    const auto due =
+        first_time + std::chrono::nanoseconds(static_cast<int64_t>(
+                         (offset - first_offset) / speed));
+    for (auto now = std::chrono::steady_clock::now(); now < due && !stopped;
+         now = std::chrono::steady_clock::now()) {
+      std::this_thread::sleep_for(std::min<std::chrono::nanoseconds>(
+          due - now, MAX_SLEEP));
+    }
+    if (stopped) {
+      return false;
+    }
+  }
+  frame = data + position + RECORD_HEADER_SIZE;
+  position += RECORD_HEADER_SIZE + frame_size;
+  frames_read++;
+  return true;
+}
+
+void FrameTraceReader::shutdown() { stopped = true; }
+
+} // namespace ClientServerChannelSpace
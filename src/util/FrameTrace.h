@@ -0,0 +1,120 @@
+/*
+ * Copyright (c) 2020 Fraunhofer FOKUS and others. All rights reserved.
+ *
+ * Contact: mosaic@fokus.fraunhofer.de
+ *
+ * This class is developed for the MOSAIC-OMNeT++ coupling.
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License version 2 as
+ * published by the Free Software Foundation;
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+ *
+ */
+
+#ifndef __FRAMETRACE_H__
+#define __FRAMETRACE_H__
+
+#include <atomic>
+#include <chrono>
+#include <cstddef>
+#include <cstdint>
+#include <cstdio>
+#include <string>
+
+static_assert(__BYTE_ORDER__ == __ORDER_LITTLE_ENDIAN__,
+              "frame traces are read in place on little-endian hosts");
+
+/**
+ * Binary trace of the frames received from the Ambassador, to replay a
+ * coupled simulation without MOSAIC. Fields are little-endian:
+ *
+ * Header, 24 bytes:
+ *   0 char[8] magic "MOSTRACE", 8 uint32 version (1), 12 uint32 reserved (0),
+ *   16 int64 wall-clock time of the recording start in ns since the epoch
+ *
+ * Record per frame, 12 bytes and the frame:
+ *   0 uint64 ns since the recording start (monotonic clock),
+ *   8 uint32 frame size, 12 the frame without length prefix
+ *
+ * Frames are stored as the read methods see them, i.e. decompressed, so a
+ * trace does not depend on CAP_COMPRESSION. The classes have no OMNeT++
+ * dependencies so that tools can use them.
+ */
+namespace ClientServerChannelSpace {
+
+class FrameTraceWriter {
+
+public:
+  FrameTraceWriter() = default;
+
+  /** Closes the file. */
+  virtual ~FrameTraceWriter();
+
+  /** Creates the file and writes the header. */
+  virtual bool open(const std::string &path);
+
+  /**
+   * Appends a frame with the time since open and flushes it, so that the
+   * trace is complete up to the last frame if the federate is killed. The
+   * recording stops at the first failed write.
+   */
+  virtual void write(const char *frame, uint32_t frame_size);
+
+private:
+  /** Logs a failed write and closes the file. */
+  void fail();
+
+  std::FILE *file = nullptr;
+  std::string path;
+  std::chrono::steady_clock::time_point start;
+};
+
+class FrameTraceReader {
+
+public:
+  FrameTraceReader() = default;
+
+  /** Unmaps the file. */
+  virtual ~FrameTraceReader();
+
+  /**
+   * Maps the file for reading.
+   * @param speed factor of the recorded pace, 0 returns frames immediately
+   */
+  virtual bool open(const std::string &path, double speed);
+
+  /**
+   * Points frame to the next frame inside the mapping. Waits until the
+   * recorded time since the first frame, divided by the speed, has passed.
+   * @return false at the end of the trace or after shutdown
+   */
+  virtual bool next(const char *&frame, uint32_t &frame_size);
+
+  /** Makes a waiting or later next() return false, thread safe. */
+  virtual void shutdown();
+
+  uint64_t getFramesRead() const { return frames_read; }
+
+private:
+  const char *data = nullptr;
+  size_t size = 0;
+  size_t position = 0;
+  double speed = 0;
+  uint64_t frames_read = 0;
+  /** recorded time and replay time of the first frame */
+  uint64_t first_offset = 0;
+  std::chrono::steady_clock::time_point first_time;
+  std::atomic<bool> stopped{false};
+};
+
+} // namespace ClientServerChannelSpace
+#endif
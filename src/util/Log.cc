@@ -24,6 +24,139 @@
 #include "Log.h"
 #include <omnetpp/clog.h>
 
+#include <chrono>
+#include <condition_variable>
+#include <cstdint>
+#include <mutex>
+#include <string>
+#include <thread>
+
+#ifdef LOG_LEVEL
+int g_log_level = LOG_LEVEL;
+#else
+int g_log_level = LOG_LEVEL_WARN;
+#endif
+
+namespace {
+
+// interval of the sink writes, the sink is woken earlier by errors, warnings
+// and large batches
+constexpr std::chrono::milliseconds LOG_SINK_INTERVAL(100);
+constexpr size_t LOG_SINK_WAKE_SIZE = 64 * 1024;
+// threads logging more than the sink writes wait above this size
+constexpr size_t LOG_SINK_MAX_SIZE = 16 * 1024 * 1024;
+
+/**
+ * Collects the log lines of all threads and writes them to LOG_OUT on a
+ * background thread, so that logging does not block on the terminal or
+ * flush each line.
+ */
+class LogSink {
+public:
+  static LogSink &instance() {
+    static LogSink sink;
+    return sink;
+  }
+
+  ~LogSink() {
+    {
+      std::lock_guard<std::mutex> lock(mutex);
+      stopping = true;
+    }
+    wake.notify_one();
+    if (thread.joinable()) {
+      thread.join();
+    }
+  }
+
+  void append(const std::string &line, bool urgent) {
+    std::unique_lock<std::mutex> lock(mutex);
+    if (pending.size() >= LOG_SINK_MAX_SIZE) {
+      drained.wait(lock, [this] { return pending.size() < LOG_SINK_MAX_SIZE; });
+    }
+    const bool was_empty = pending.empty();
+    pending += line;
+    appended += line.size();
+    if (urgent) {
+      this->urgent = true;
+    }
+    if (!thread.joinable()) {
+      thread = std::thread(&LogSink::run, this);
+    }
+    if (was_empty || urgent || pending.size() >= LOG_SINK_WAKE_SIZE) {
+      lock.unlock();
+      wake.notify_one();
+    }
+  }
+
+  void flush() {
+    std::unique_lock<std::mutex> lock(mutex);
+    if (!thread.joinable()) {
+      return;
+    }
+    const uint64_t target = appended;
+    urgent = true;
+    wake.notify_one();
+    drained.wait(lock, [this, target] { return written >= target; });
+  }
+
+private:
+  LogSink() = default;
+
+  void run() {
+    std::string writing;
+    std::unique_lock<std::mutex> lock(mutex);
+    while (true) {
+      wake.wait(lock, [this] { return stopping || !pending.empty(); });
+      wake.wait_for(lock, LOG_SINK_INTERVAL, [this] {
+        return stopping || urgent || pending.size() >= LOG_SINK_WAKE_SIZE;
+      });
+      if (pending.empty()) {
+        if (stopping) {
+          return;
+        }
+        continue;
+      }
+      writing.swap(pending);
+      urgent = false;
+      lock.unlock();
+      LOG_OUT.write(writing.data(), writing.size());
+      LOG_OUT.flush();
+      lock.lock();
+      written += writing.size();
+      writing.clear();
+      drained.notify_all();
+    }
+  }
+
+  std::mutex mutex;
+  std::condition_variable wake;    // pending lines or stopping
+  std::condition_variable drained; // a batch was written
+  std::string pending;
+  uint64_t appended = 0; // bytes handed over to the sink
+  uint64_t written = 0;  // bytes written to LOG_OUT
+  bool urgent = false;
+  bool stopping = false;
+  std::thread thread;
+};
+
+thread_local std::ostringstream t_log_line;
+
+} // namespace
+
+std::ostream &log_begin_line() {
+  t_log_line.str(std::string());
+  return t_log_line;
+}
+
+void log_end_line(int level) {
+  t_log_line << '\n';
+  LogSink::instance().append(t_log_line.str(),
+                             (level & LOG_LEVEL_WARN) != 0);
+}
+
+void log_flush() { LogSink::instance().flush(); }
+
 void set_log_level(omnetpp::LogLevel omnetpp_level) {
   // map OMNeT++ log level to LogLevel
   switch (omnetpp_level) {
@@ -51,13 +184,6 @@ void set_log_level(omnetpp::LogLevel omnetpp_level) {
   }
 }
 
-bool is_LOG_enabled(int level) {
-  if (g_log_level & level)
-    return true;
-  else
-    return false;
-}
-
 // copied from ns-3.34, file: core/log.cc
 ParameterLogger::ParameterLogger(std::ostream &os) : m_first(true), m_os(os) {}
 
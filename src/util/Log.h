@@ -30,7 +30,7 @@
 
 #include <omnetpp/clog.h>
 
-// default log stream
+// stream the background sink writes the log lines to
 #ifndef LOG_OUT
 #define LOG_OUT std::cout
 #endif
@@ -119,17 +119,40 @@ ParameterLogger &ParameterLogger::operator<<(const T param) {
   return *this;
 }
 
-// define log level with default value or use defined preprocessor symbol
-// LOG_LEVEL
-#ifdef LOG_LEVEL
-static int g_log_level = LOG_LEVEL;
+// levels compiled into the binary, the macros of all other levels are removed
+// by the compiler. Release builds keep warnings and errors only, unless built
+// with premake5 --with-release-logging
+#ifndef LOG_COMPILED_LEVEL
+#ifdef NDEBUG
+#define LOG_COMPILED_LEVEL LOG_LEVEL_WARN
 #else
-static int g_log_level = LOG_LEVEL_WARN;
+#define LOG_COMPILED_LEVEL LOG_LEVEL_ALL
 #endif
+#endif
+
+// log level at runtime, initialized with the preprocessor symbol LOG_LEVEL or
+// warnings and errors
+extern int g_log_level;
 
 void set_log_level(omnetpp::LogLevel omnetpp_level);
 
-bool is_LOG_enabled(int level);
+inline bool is_LOG_enabled(int level) { return (g_log_level & level) != 0; }
+
+/**
+ * Returns the cleared line buffer of the calling thread.
+ */
+std::ostream &log_begin_line();
+
+/**
+ * Hands the line of the calling thread over to the background sink. Errors
+ * and warnings wake the sink at once, other lines are written in batches.
+ */
+void log_end_line(int level);
+
+/**
+ * Blocks until all lines logged so far are written to LOG_OUT.
+ */
+void log_flush();
 
 // define simplified LOG makros (compare to official ns3 logging macros)
 
@@ -139,7 +162,7 @@ bool is_LOG_enabled(int level);
   static std::string g_LOG_component_name = name;
 
 // simplified prefix
-#define LOG_APPEND_PREFIX LOG_OUT << g_LOG_component_name << ": ";
+#define LOG_APPEND_PREFIX(os) os << g_LOG_component_name << ": ";
 
 // copied from ns-3.34, file: core/log.h
 #define LOG_ERROR(msg) NS_LOG(LOG_ERROR, msg)
@@ -160,9 +183,11 @@ bool is_LOG_enabled(int level);
 #define NS_LOG(level, msg)                                                     \
   LOG_CONDITION                                                                \
   do {                                                                         \
-    if (is_LOG_enabled(level)) {                                               \
-      LOG_APPEND_PREFIX;                                                       \
-      LOG_OUT << msg << std::endl;                                             \
+    if ((LOG_COMPILED_LEVEL & (level)) && is_LOG_enabled(level)) {             \
+      std::ostream &log_os = log_begin_line();                                 \
+      LOG_APPEND_PREFIX(log_os);                                               \
+      log_os << msg;                                                           \
+      log_end_line(level);                                                     \
     }                                                                          \
   } while (false)
 
@@ -170,11 +195,13 @@ bool is_LOG_enabled(int level);
 #define LOG_FUNCTION(parameters)                                               \
   LOG_CONDITION                                                                \
   do {                                                                         \
-    if (is_LOG_enabled(LOG_FUNCTION)) {                                        \
-      LOG_APPEND_PREFIX;                                                       \
-      LOG_OUT << __FUNCTION__ << "(";                                          \
-      ParameterLogger(LOG_OUT) << parameters;                                  \
-      LOG_OUT << ")" << std::endl;                                             \
+    if ((LOG_COMPILED_LEVEL & LOG_FUNCTION) && is_LOG_enabled(LOG_FUNCTION)) { \
+      std::ostream &log_os = log_begin_line();                                 \
+      LOG_APPEND_PREFIX(log_os);                                               \
+      log_os << __FUNCTION__ << "(";                                           \
+      ParameterLogger(log_os) << parameters;                                   \
+      log_os << ")";                                                           \
+      log_end_line(LOG_FUNCTION);                                              \
     }                                                                          \
   } while (false)
 
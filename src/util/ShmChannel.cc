@@ -0,0 +1,329 @@
+/*
+ * Copyright (c) 2020 Fraunhofer FOKUS and others. All rights reserved.
+ *
+ * Contact: mosaic@fokus.fraunhofer.de
+ *
+ * This class is developed for the MOSAIC-OMNeT++ coupling.
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License version 2 as
+ * published by the Free Software Foundation;
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+ *
+ */
+
+#include "ShmChannel.h"
+
+#include <algorithm>
+#include <chrono>
+#include <climits>
+#include <cstring>
+#include <errno.h>
+#include <fcntl.h>
+#include <iostream>
+#include <linux/futex.h>
+#include <new>
+#include <signal.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+
+namespace ClientServerChannelSpace {
+
+namespace {
+
+constexpr uint32_t SEGMENT_MAGIC = 0x4d4f5332; // "MOS2"
+constexpr uint32_t STATE_CREATED = 0;
+constexpr uint32_t STATE_ATTACHED = 1;
+constexpr uint32_t STATE_CLOSED = 2;
+
+/** Polls before sleeping, a round trip is usually shorter than a wakeup. */
+constexpr int SPIN_COUNT = 4000;
+
+/** Spinning only delays the peer if both share a single CPU. */
+int spinCount() {
+  static const int count = sysconf(_SC_NPROCESSORS_ONLN) > 1 ? SPIN_COUNT : 0;
+  return count;
+}
+
+void futexWait(std::atomic<uint32_t> &word, uint32_t expected) {
+  syscall(SYS_futex, reinterpret_cast<uint32_t *>(&word), FUTEX_WAIT, expected,
+          nullptr, nullptr, 0);
+}
+
+void futexWake(std::atomic<uint32_t> &word, int count) {
+  syscall(SYS_futex, reinterpret_cast<uint32_t *>(&word), FUTEX_WAKE, count,
+          nullptr, nullptr, 0);
+}
+
+inline void cpuRelax() {
+#if defined(__x86_64__) || defined(__i386__)
+  __builtin_ia32_pause();
+#endif
+}
+
+} // namespace
+
+ShmChannel::~ShmChannel() {
+  if (segment == nullptr) {
+    return;
+  }
+  shutdown();
+  munmap(segment, segment_size);
+  if (owner) {
+    shm_unlink(segment_name.c_str());
+  }
+}
+
+void ShmChannel::shutdown() {
+  if (segment == nullptr) {
+    return;
+  }
+  segment->state.store(STATE_CLOSED);
+  futexWake(segment->state, INT_MAX);
+  for (Ring &ring : segment->rings) {
+    ring.data_seq.fetch_add(1);
+    futexWake(ring.data_seq, INT_MAX);
+    ring.space_seq.fetch_add(1);
+    futexWake(ring.space_seq, INT_MAX);
+  }
+}
+
+/**
+ * Creates a new shared memory segment. A left over segment of a previous run
+ * with the same name is replaced, a segment of a running process is not.
+ *
+ * @param name POSIX shared memory name, e.g. "/omnetpp-federate-4998"
+ * @return true if successful
+ */
+bool ShmChannel::create(const std::string &name) {
+  int fd = shm_open(name.c_str(), O_CREAT | O_EXCL | O_RDWR, 0600);
+  if (fd < 0 && errno == EEXIST && unlinkStale(name)) {
+    fd = shm_open(name.c_str(), O_CREAT | O_EXCL | O_RDWR, 0600);
+  }
+  if (fd < 0) {
+    std::cerr << "Error: ShmChannel could not create " << name << " - "
+              << strerror(errno) << std::endl;
+    return false;
+  }
+  segment_name = name;
+  owner = true;
+  if (ftruncate(fd, sizeof(Segment) + 2 * RING_SIZE) < 0 || !map(fd, true)) {
+    std::cerr << "Error: ShmChannel could not map " << name << " - "
+              << strerror(errno) << std::endl;
+    close(fd);
+    shm_unlink(name.c_str());
+    owner = false;
+    return false;
+  }
+  close(fd);
+  return true;
+}
+
+/**
+ * Opens a segment created by the peer and signals that both sides are
+ * attached.
+ *
+ * @param name POSIX shared memory name used by the creator
+ * @return true if successful
+ */
+bool ShmChannel::open(const std::string &name) {
+  const int fd = shm_open(name.c_str(), O_RDWR, 0600);
+  if (fd < 0) {
+    return false;
+  }
+  struct stat info;
+  if (fstat(fd, &info) < 0 ||
+      static_cast<size_t>(info.st_size) < sizeof(Segment) + 2 * RING_SIZE ||
+      !map(fd, false)) {
+    close(fd);
+    return false;
+  }
+  close(fd);
+  segment_name = name;
+  if (segment->magic != SEGMENT_MAGIC) {
+    std::cerr << "Error: ShmChannel " << name << " has an unknown layout"
+              << std::endl;
+    return false;
+  }
+  segment->state.store(STATE_ATTACHED);
+  futexWake(segment->state, INT_MAX);
+  return true;
+}
+
+bool ShmChannel::waitForPeer() {
+  uint32_t state;
+  while ((state = segment->state.load()) == STATE_CREATED) {
+    futexWait(segment->state, STATE_CREATED);
+  }
+  // the name is not needed anymore once both sides mapped the segment
+  shm_unlink(segment_name.c_str());
+  owner = false;
+  return state == STATE_ATTACHED;
+}
+
+void ShmChannel::setBusyPoll(std::chrono::nanoseconds duration) {
+  busy_poll = duration;
+}
+
+ssize_t ShmChannel::receive(char *buffer, size_t max_bytes) {
+  uint64_t tail = in_ring->tail.load(std::memory_order_relaxed);
+  uint64_t head;
+  while ((head = in_ring->head.load(std::memory_order_acquire)) == tail) {
+    if (segment->state.load(std::memory_order_relaxed) == STATE_CLOSED) {
+      return 0;
+    }
+    wait(in_ring->data_seq, in_ring->consumer_waiting, in_ring->head, tail);
+  }
+  const size_t count = std::min<uint64_t>(max_bytes, head - tail);
+  const size_t offset = tail % RING_SIZE;
+  const size_t first = std::min(count, RING_SIZE - offset);
+  memcpy(buffer, in_data + offset, first);
+  memcpy(buffer + first, in_data, count - first);
+  in_ring->tail.store(tail + count);
+  wake(in_ring->space_seq, in_ring->producer_waiting);
+  return count;
+}
+
+ssize_t ShmChannel::send(const char *data, size_t num_bytes) {
+  size_t written = 0;
+  while (written < num_bytes) {
+    if (segment->state.load(std::memory_order_relaxed) == STATE_CLOSED) {
+      if (written > 0) {
+        return written;
+      }
+      errno = EPIPE;
+      return -1;
+    }
+    const uint64_t head = out_ring->head.load(std::memory_order_relaxed);
+    const uint64_t tail = out_ring->tail.load(std::memory_order_acquire);
+    const size_t space = RING_SIZE - (head - tail);
+    if (space == 0) {
+      wait(out_ring->space_seq, out_ring->producer_waiting, out_ring->tail,
+           tail);
+      continue;
+    }
+    const size_t count = std::min(space, num_bytes - written);
+    const size_t offset = head % RING_SIZE;
+    const size_t first = std::min(count, RING_SIZE - offset);
+    memcpy(out_data + offset, data + written, first);
+    memcpy(out_data, data + written + first, count - first);
+    out_ring->head.store(head + count);
+    wake(out_ring->data_seq, out_ring->consumer_waiting);
+    written += count;
+  }
+  return written;
+}
+
+/**
+ * Removes the segment if its creator has ended or closed it.
+ * @return true if the name is free again
+ */
+bool ShmChannel::unlinkStale(const std::string &name) {
+  const int fd = shm_open(name.c_str(), O_RDONLY, 0600);
+  if (fd < 0) {
+    return errno == ENOENT;
+  }
+  struct stat info;
+  void *address = MAP_FAILED;
+  if (fstat(fd, &info) == 0 &&
+      static_cast<size_t>(info.st_size) >= sizeof(Segment)) {
+    address = mmap(nullptr, sizeof(Segment), PROT_READ, MAP_SHARED, fd, 0);
+  }
+  close(fd);
+  if (address == MAP_FAILED) {
+    errno = EEXIST;
+    return false;
+  }
+  const Segment *existing = static_cast<const Segment *>(address);
+  const bool stale =
+      existing->magic == SEGMENT_MAGIC &&
+      (existing->state.load() == STATE_CLOSED ||
+       (kill(existing->creator, 0) < 0 && errno == ESRCH));
+  munmap(address, sizeof(Segment));
+  if (!stale) {
+    errno = EEXIST;
+    return false;
+  }
+  return shm_unlink(name.c_str()) == 0 || errno == ENOENT;
+}
+
+bool ShmChannel::map(int fd, bool initialize) {
+  segment_size = sizeof(Segment) + 2 * RING_SIZE;
+  void *address =
+      mmap(nullptr, segment_size, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+  if (address == MAP_FAILED) {
+    return false;
+  }
+  if (initialize) {
+    segment = new (address) Segment();
+    segment->magic = SEGMENT_MAGIC;
+    segment->state.store(STATE_CREATED);
+    segment->creator = getpid();
+  } else {
+    segment = static_cast<Segment *>(address);
+  }
+  char *data = static_cast<char *>(address) + sizeof(Segment);
+  const int in = initialize ? 0 : 1;
+  in_ring = &segment->rings[in];
+  in_data = data + in * RING_SIZE;
+  out_ring = &segment->rings[1 - in];
+  out_data = data + (1 - in) * RING_SIZE;
+  return true;
+}
+
+/**
+ * Waits until position differs from unchanged. Spins shortly and then sleeps
+ * on the futex word seq after announcing the wait in waiting, so that the
+ * other side only issues a wake system call if someone is sleeping.
+ */
+void ShmChannel::wait(std::atomic<uint32_t> &seq,
+                      std::atomic<uint32_t> &waiting,
+                      const std::atomic<uint64_t> &position,
+                      uint64_t unchanged) {
+  for (int i = 0; i < spinCount(); i++) {
+    if (position.load(std::memory_order_acquire) != unchanged) {
+      return;
+    }
+    cpuRelax();
+  }
+  if (busy_poll.count() > 0) {
+    // the clock is read every few polls only
+    const auto deadline = std::chrono::steady_clock::now() + busy_poll;
+    do {
+      for (int i = 0; i < 64; i++) {
+        if (position.load(std::memory_order_acquire) != unchanged) {
+          return;
+        }
+        cpuRelax();
+      }
+    } while (std::chrono::steady_clock::now() < deadline &&
+             segment->state.load(std::memory_order_relaxed) != STATE_CLOSED);
+  }
+  const uint32_t observed = seq.load();
+  waiting.store(1);
+  if (position.load() == unchanged &&
+      segment->state.load() != STATE_CLOSED) {
+    futexWait(seq, observed);
+  }
+  waiting.store(0, std::memory_order_relaxed);
+}
+
+void ShmChannel::wake(std::atomic<uint32_t> &seq,
+                      std::atomic<uint32_t> &waiting) {
+  seq.fetch_add(1);
+  if (waiting.load()) {
+    futexWake(seq, 1);
+  }
+}
+
+} // namespace ClientServerChannelSpace
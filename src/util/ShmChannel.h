@@ -0,0 +1,126 @@
+/*
+ * Copyright (c) 2020 Fraunhofer FOKUS and others. All rights reserved.
+ *
+ * Contact: mosaic@fokus.fraunhofer.de
+ *
+ * This class is developed for the MOSAIC-OMNeT++ coupling.
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License version 2 as
+ * published by the Free Software Foundation;
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+ *
+ */
+
+#ifndef __SHMCHANNEL_H__
+#define __SHMCHANNEL_H__
+
+#include <atomic>
+#include <chrono>
+#include <cstddef>
+#include <cstdint>
+#include <string>
+#include <sys/types.h>
+
+namespace ClientServerChannelSpace {
+
+/**
+ * Bidirectional byte stream between two processes on the same host, built
+ * from two single-producer/single-consumer rings in a POSIX shared memory
+ * segment. A blocked reader or writer sleeps on a futex and is only woken if
+ * it announced that it is waiting, so a busy stream needs no system calls.
+ *
+ * The side calling create() (the federate) reads ring 0 and writes ring 1,
+ * the side calling open() (the Ambassador) uses them the other way round.
+ * The class has no OMNeT++ dependencies so that stand-in peers can use it.
+ */
+class ShmChannel {
+
+public:
+  /** Capacity of each ring in bytes. */
+  static constexpr size_t RING_SIZE = 1024 * 1024;
+
+  ShmChannel() = default;
+
+  /** Marks the channel as closed for the peer and unmaps the segment. */
+  virtual ~ShmChannel();
+
+  /** Creates the segment with the given name (server side). */
+  virtual bool create(const std::string &name);
+
+  /** Opens a segment created by the peer (client side). */
+  virtual bool open(const std::string &name);
+
+  /** Marks the channel as closed and wakes blocked calls of both sides. */
+  virtual void shutdown();
+
+  /** Blocks until the peer opened the segment. */
+  virtual bool waitForPeer();
+
+  /** Keeps polling for this duration before a blocked call sleeps. */
+  virtual void setBusyPoll(std::chrono::nanoseconds duration);
+
+  /**
+   * Blocks until data is available and copies up to max_bytes into buffer.
+   * @return number of bytes copied, 0 if the peer closed the channel
+   */
+  virtual ssize_t receive(char *buffer, size_t max_bytes);
+
+  /**
+   * Blocks until all bytes are written to the ring.
+   * @return number of bytes written, less if the channel was closed meanwhile,
+   *         -1 with errno EPIPE if it was closed before
+   */
+  virtual ssize_t send(const char *data, size_t num_bytes);
+
+private:
+  struct alignas(64) Ring {
+    /** Total number of bytes written, only modified by the producer. */
+    alignas(64) std::atomic<uint64_t> head;
+    /** Total number of bytes read, only modified by the consumer. */
+    alignas(64) std::atomic<uint64_t> tail;
+    /** Futex word incremented after each write, consumer waits on it. */
+    alignas(64) std::atomic<uint32_t> data_seq;
+    std::atomic<uint32_t> consumer_waiting;
+    /** Futex word incremented after each read, producer waits on it. */
+    alignas(64) std::atomic<uint32_t> space_seq;
+    std::atomic<uint32_t> producer_waiting;
+  };
+
+  struct Segment {
+    uint32_t magic;
+    /** Futex word: 0 created, 1 peer attached, 2 one side closed. */
+    std::atomic<uint32_t> state;
+    /** Process that created the segment, tells whether a name is stale. */
+    pid_t creator;
+    Ring rings[2];
+  };
+
+  Segment *segment = nullptr;
+  size_t segment_size = 0;
+  std::string segment_name;
+  bool owner = false;
+  std::chrono::nanoseconds busy_poll{0};
+
+  Ring *in_ring = nullptr;
+  char *in_data = nullptr;
+  Ring *out_ring = nullptr;
+  char *out_data = nullptr;
+
+  bool map(int fd, bool initialize);
+  static bool unlinkStale(const std::string &name);
+  void wait(std::atomic<uint32_t> &seq, std::atomic<uint32_t> &waiting,
+            const std::atomic<uint64_t> &position, uint64_t unchanged);
+  void wake(std::atomic<uint32_t> &seq, std::atomic<uint32_t> &waiting);
+};
+
+} // namespace ClientServerChannelSpace
+#endif
@@ -0,0 +1,146 @@
+/*
+ * Copyright (c) 2020 Fraunhofer FOKUS and others. All rights reserved.
+ *
+ * Contact: mosaic@fokus.fraunhofer.de
+ *
+ * This class is developed for the MOSAIC-OMNeT++ coupling.
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License version 2 as
+ * published by the Free Software Foundation;
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+ *
+ */
+
+#include "SpanTrace.h"
+
+#include <algorithm>
+#include <cerrno>
+#include <cstring>
+#include <fstream>
+#include <iomanip>
+#include <iostream>
+
+namespace ClientServerChannelSpace {
+
+namespace {
+
+/** Spans reserved with the first span of a thread. */
+constexpr size_t INITIAL_SPANS = 64 * 1024;
+
+/** Writes a JSON string, names are identifiers but may contain anything. */
+void writeJsonString(std::ostream &out, const char *text) {
+  out << '"';
+  for (const char *c = text; *c != '\0'; c++) {
+    if (*c == '"' || *c == '\\') {
+      out << '\\';
+    }
+    out << *c;
+  }
+  out << '"';
+}
+
+/** Writes ns as us with three decimals, the unit of the trace format. */
+void writeMicroseconds(std::ostream &out, uint64_t ns) {
+  out << ns / 1000 << '.' << std::setw(3) << std::setfill('0') << ns % 1000;
+}
+
+} // namespace
+
+void SpanTrace::enable(size_t max_spans) {
+  std::lock_guard<std::mutex> lock(threads_mutex);
+  for (ThreadSpans *thread : threads) {
+    thread->spans.clear();
+    thread->dropped = 0;
+  }
+  max_spans_per_thread = max_spans;
+  origin = now();
+  active.store(true, std::memory_order_relaxed);
+}
+
+void SpanTrace::setThreadName(const char *name) { threadSpans().name = name; }
+
+void SpanTrace::add(const char *name, const char *category, uint64_t start,
+                    uint64_t end) {
+  ThreadSpans &thread = threadSpans();
+  if (thread.spans.size() >= max_spans_per_thread) {
+    if (thread.dropped++ == 0) {
+      std::cerr << "Warn: SpanTrace keeps " << max_spans_per_thread
+                << " spans of thread " << thread.name
+                << ", later spans are dropped" << std::endl;
+    }
+    return;
+  }
+  if (thread.spans.capacity() == 0) {
+    // not in threadSpans(), naming a thread must not allocate while disabled
+    thread.spans.reserve(std::min(INITIAL_SPANS, max_spans_per_thread));
+  }
+  thread.spans.push_back(Span{name, category, start, end - start});
+}
+
+bool SpanTrace::write(const std::string &path) {
+  std::ofstream out(path);
+  if (!out) {
+    std::cerr << "Error: SpanTrace could not create " << path << " - "
+              << strerror(errno) << std::endl;
+    return false;
+  }
+  std::lock_guard<std::mutex> lock(threads_mutex);
+  out << "{\"displayTimeUnit\": \"ns\", \"traceEvents\": [";
+  const char *separator = "\n";
+  for (const ThreadSpans *thread : threads) {
+    out << separator << "{\"name\": \"thread_name\", \"ph\": \"M\", "
+        << "\"pid\": 1, \"tid\": " << thread->tid << ", \"args\": {\"name\": ";
+    writeJsonString(out, thread->name);
+    out << "}}";
+    separator = ",\n";
+    for (const Span &span : thread->spans) {
+      if (span.start < origin) {
+        continue;
+      }
+      out << separator << "{\"name\": ";
+      writeJsonString(out, span.name);
+      out << ", \"cat\": ";
+      writeJsonString(out, span.category);
+      out << ", \"ph\": \"X\", \"pid\": 1, \"tid\": " << thread->tid
+          << ", \"ts\": ";
+      writeMicroseconds(out, span.start - origin);
+      out << ", \"dur\": ";
+      writeMicroseconds(out, span.duration);
+      out << "}";
+    }
+  }
+  out << "\n]}\n";
+  return static_cast<bool>(out);
+}
+
+uint64_t SpanTrace::getDropped() {
+  std::lock_guard<std::mutex> lock(threads_mutex);
+  uint64_t dropped = 0;
+  for (const ThreadSpans *thread : threads) {
+    dropped += thread->dropped;
+  }
+  return dropped;
+}
+
+SpanTrace::ThreadSpans &SpanTrace::threadSpans() {
+  thread_local ThreadSpans *spans = nullptr;
+  if (spans == nullptr) {
+    std::lock_guard<std::mutex> lock(threads_mutex);
+    spans = new ThreadSpans();
+    spans->tid = static_cast<int>(threads.size()) + 1;
+    spans->name = "thread";
+    threads.push_back(spans);
+  }
+  return *spans;
+}
+
+} // namespace ClientServerChannelSpace
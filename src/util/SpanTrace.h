@@ -0,0 +1,129 @@
+/*
+ * Copyright (c) 2020 Fraunhofer FOKUS and others. All rights reserved.
+ *
+ * Contact: mosaic@fokus.fraunhofer.de
+ *
+ * This class is developed for the MOSAIC-OMNeT++ coupling.
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License version 2 as
+ * published by the Free Software Foundation;
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+ *
+ */
+
+#ifndef __SPANTRACE_H__
+#define __SPANTRACE_H__
+
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <mutex>
+#include <string>
+#include <vector>
+
+namespace ClientServerChannelSpace {
+
+/**
+ * Wall-clock spans of the federate in the Chrome trace event format, which
+ * chrome://tracing and the Perfetto UI display as a timeline per thread.
+ * Spans are kept in memory per thread and written as JSON by write() at the
+ * end of the run, so tracing does not add I/O to the simulation.
+ *
+ * Names and categories are not copied, they must live until write(), e.g.
+ * string literals or OMNeT++ class names. While tracing is disabled a span
+ * costs a load and a branch. enable() and write() must not run while other
+ * threads add spans. The class has no OMNeT++ dependencies.
+ */
+class SpanTrace {
+
+public:
+  /** Default of the spans kept per thread, 32 bytes each. */
+  static constexpr size_t DEFAULT_MAX_SPANS = 1024 * 1024;
+
+  /** Measures its lifetime as a span if tracing is enabled. */
+  class Scope {
+  public:
+    Scope(const char *name, const char *category)
+        : name(name), category(category), start(enabled() ? now() : 0) {}
+    ~Scope() {
+      if (start != 0) {
+        add(name, category, start, now());
+      }
+    }
+    Scope(const Scope &) = delete;
+    Scope &operator=(const Scope &) = delete;
+
+  private:
+    const char *name;
+    const char *category;
+    uint64_t start;
+  };
+
+  /**
+   * Drops the spans of earlier runs and starts tracing.
+   * @param max_spans spans kept per thread, later ones are counted as dropped
+   */
+  static void enable(size_t max_spans = DEFAULT_MAX_SPANS);
+
+  static void disable() { active.store(false, std::memory_order_relaxed); }
+
+  static bool enabled() { return active.load(std::memory_order_relaxed); }
+
+  /** Names the calling thread in the timeline. */
+  static void setThreadName(const char *name);
+
+  /** Adds a span of the calling thread, times from now(). */
+  static void add(const char *name, const char *category, uint64_t start,
+                  uint64_t end);
+
+  /** Writes the spans of all threads as Chrome trace JSON. */
+  static bool write(const std::string &path);
+
+  /** Spans that did not fit into the buffer of their thread. */
+  static uint64_t getDropped();
+
+  /** Monotonic time in ns, never 0. */
+  static uint64_t now() {
+    return std::chrono::duration_cast<std::chrono::nanoseconds>(
+               std::chrono::steady_clock::now().time_since_epoch())
+        .count();
+  }
+
+private:
+  struct Span {
+    const char *name;
+    const char *category;
+    uint64_t start;
+    uint64_t duration;
+  };
+
+  struct ThreadSpans {
+    int tid;
+    const char *name;
+    std::vector<Span> spans;
+    uint64_t dropped = 0;
+  };
+
+  /** Buffer of the calling thread, registered by the first call. */
+  static ThreadSpans &threadSpans();
+
+  inline static std::atomic<bool> active{false};
+  /** time of enable(), the timeline starts at 0 */
+  inline static uint64_t origin = 0;
+  inline static size_t max_spans_per_thread = DEFAULT_MAX_SPANS;
+  /** buffers of all threads that added spans, they outlive their threads */
+  inline static std::mutex threads_mutex;
+  inline static std::vector<ThreadSpans *> threads;
+};
+
+} // namespace ClientServerChannelSpace
+#endif
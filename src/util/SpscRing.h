@@ -0,0 +1,132 @@
+/*
+ * Copyright (c) 2020 Fraunhofer FOKUS and others. All rights reserved.
+ *
+ * Contact: mosaic@fokus.fraunhofer.de
+ *
+ * This class is developed for the MOSAIC-OMNeT++ coupling.
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License version 2 as
+ * published by the Free Software Foundation;
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+ *
+ */
+
+#ifndef __SPSCRING_H__
+#define __SPSCRING_H__
+
+#include <atomic>
+#include <condition_variable>
+#include <cstddef>
+#include <cstdint>
+#include <mutex>
+#include <unistd.h>
+#include <vector>
+
+namespace ClientServerChannelSpace {
+
+/**
+ * Bounded queue between one producer and one consumer thread. The slots are
+ * constructed once and filled in place, so elements keep the memory they
+ * allocated, e.g. the capacity of vectors. Both sides spin shortly before they
+ * sleep, and only wake the other side if it announced that it sleeps.
+ */
+template <typename T> class SpscRing {
+
+public:
+  explicit SpscRing(size_t capacity) : slots(capacity) {}
+
+  /** Slot to fill next, blocks while the ring is full. Null once closed. */
+  T *beginPush() {
+    const uint64_t position = head.load(std::memory_order_relaxed);
+    waitFor(producer_waiting, [&] {
+      return position - tail.load() < slots.size() ||
+             closed.load();
+    });
+    if (closed.load()) {
+      return nullptr;
+    }
+    return &slots[position % slots.size()];
+  }
+
+  /** Hands the slot returned by beginPush to the consumer. */
+  void commitPush() {
+    head.store(head.load(std::memory_order_relaxed) + 1);
+    notify(consumer_waiting);
+  }
+
+  /** Oldest filled slot, blocks while the ring is empty. */
+  T &front() {
+    const uint64_t position = tail.load(std::memory_order_relaxed);
+    waitFor(consumer_waiting, [&] {
+      return head.load() != position;
+    });
+    return slots[position % slots.size()];
+  }
+
+  /** Returns the slot returned by front to the producer. */
+  void pop() {
+    tail.store(tail.load(std::memory_order_relaxed) + 1);
+    notify(producer_waiting);
+  }
+
+  /** Lets a blocked or later beginPush return null. */
+  void close() {
+    closed.store(true);
+    notify(producer_waiting);
+  }
+
+private:
+  /** Polls before sleeping, the other side usually answers within it. */
+  static constexpr int SPIN_COUNT = 4000;
+
+  std::vector<T> slots;
+  /** Number of pushed slots, only modified by the producer. */
+  alignas(64) std::atomic<uint64_t> head{0};
+  /** Number of popped slots, only modified by the consumer. */
+  alignas(64) std::atomic<uint64_t> tail{0};
+  alignas(64) std::atomic<bool> closed{false};
+  std::atomic<bool> producer_waiting{false};
+  std::atomic<bool> consumer_waiting{false};
+  std::mutex mutex;
+  std::condition_variable condition;
+
+  /** Spinning only delays the other thread if both share a single CPU. */
+  static int spinCount() {
+    static const int count = sysconf(_SC_NPROCESSORS_ONLN) > 1 ? SPIN_COUNT : 0;
+    return count;
+  }
+
+  template <typename Predicate>
+  void waitFor(std::atomic<bool> &waiting, Predicate ready) {
+    for (int i = 0; i < spinCount(); i++) {
+      if (ready()) {
+        return;
+      }
+    }
+    // ready() is checked after waiting is set and notify() checks waiting
+    // after the update, so at least one side sees the other
+    std::unique_lock<std::mutex> lock(mutex);
+    waiting.store(true);
+    condition.wait(lock, ready);
+    waiting.store(false);
+  }
+
+  void notify(std::atomic<bool> &waiting) {
+    if (waiting.load()) {
+      std::lock_guard<std::mutex> lock(mutex);
+      condition.notify_all();
+    }
+  }
+};
+
+} // namespace ClientServerChannelSpace
+#endif